@@ -0,0 +1,966 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "Slab.h"
+#include "Intern.h"
+
+/*
+** An adaptive radix tree (ART) that stores names in SORTED lexicographic order
+**
+** Does the same job as SinglyLinkedList.c and DoublyLinkedList.c, but instead of
+** walking a chain comparing whole names, every level of the tree looks at a single
+** character of the name. Inner nodes come in four sizes and switch between them as
+** children come and go, so a node only ever takes about as much room as it has children:
+**   Node4:   up to 4 children, the characters and children in two small sorted arrays
+**   Node16:  up to 16, same layout, all 16 characters compared at once with SSE2
+**   Node48:  up to 48 children, plus a 256 entry array from character to child slot
+**   Node256: one child pointer for every possible character
+** Chains of nodes with a single child are squashed into one node that remembers the
+** characters it skipped (path compression). Up to MAX_PREFIX of them are kept in the
+** node, longer ones are checked against a name further down when they need to be.
+**
+** Every name ends with its '\0', which is treated as one more character. That way no
+** name ever ends inside another one ("ann" ends at a '\0' child, "anna" keeps going),
+** and since '\0' sorts first, walking the children in order gives the names in order.
+** Leaves point at the tree's interned copy of the name (see Intern.h) and count how many
+** times it was added, so like the lists a name can be in the tree more than once.
+**
+** Time Complexity (k is the length of the name, not the number of names)
+** Insert: O(k)
+** Delete: O(k)
+** Search: O(k)
+** Print:  O(n) (In order walk of the tree)
+*/
+#define MAX_LENGTH 100
+// Characters of a compressed path kept in the node itself
+#define MAX_PREFIX 10
+
+enum node_type {
+	NODE4,
+	NODE16,
+	NODE48,
+	NODE256
+};
+
+// Children are either inner nodes or leaves. Leaves are told apart by
+// having the low bit of the pointer set, which nodes never have.
+#define IS_LEAF(x) (((uintptr_t)(x) & 1) != 0)
+#define TO_LEAF(x) ((struct leaf*)((uintptr_t)(x) & ~(uintptr_t)1))
+#define MAKE_LEAF(x) ((struct art_node*)((uintptr_t)(x) | 1))
+
+// Start of every inner node
+struct art_node {
+	uint8_t type;
+	uint16_t num_children;
+	uint32_t prefix_length; // Characters skipped by the compressed path
+	unsigned char prefix[MAX_PREFIX]; // The first of them
+};
+
+struct node4 {
+	struct art_node n;
+	unsigned char keys[4];
+	struct art_node* children[4];
+};
+
+struct node16 {
+	struct art_node n;
+	unsigned char keys[16];
+	struct art_node* children[16];
+};
+
+struct node48 {
+	struct art_node n;
+	unsigned char index[256]; // Slot + 1 of the child for each character, 0 for none
+	struct art_node* children[48];
+};
+
+struct node256 {
+	struct art_node n;
+	struct art_node* children[256];
+};
+
+struct leaf {
+	const char* name; // Interned, so equal names are the same pointer
+	int count;        // Times the name was added
+};
+
+struct tree {
+	struct art_node* root;
+	struct slab* pools[4];     // Nodes of each type come from here if the tree opted into slabs
+	struct slab* leaves;
+	struct intern_pool* names; // Every leaf's name is this pool's copy
+	long num_nodes[4];         // Inner nodes of each type
+	long num_names;            // Counting repeats
+};
+
+static const size_t node_sizes[4] = {
+	sizeof(struct node4), sizeof(struct node16), sizeof(struct node48), sizeof(struct node256)
+};
+static const char* node_names[4] = { "Node4", "Node16", "Node48", "Node256" };
+
+struct tree* create_tree(int use_slab);
+void insert(struct tree* tree, char name[]);
+int find(struct tree* tree, char name[]);
+void print_list(struct tree* tree);
+int delete_node(struct tree* tree, char name[]);
+void delete_tree(struct tree* tree);
+int load_file(struct tree* tree, const char* filename);
+void print_stats(struct tree* tree);
+
+
+// Create a new empty tree, with its own slabs of nodes and leaves if use_slab is set
+struct tree* create_tree(int use_slab)
+{
+	struct tree* tree;
+	int i;
+	
+	tree = malloc(sizeof(struct tree));
+	tree->root = NULL;
+	for (i = 0; i < 4; i++)
+	{
+		tree->pools[i] = use_slab ? slab_create(node_sizes[i]) : NULL;
+		tree->num_nodes[i] = 0;
+	}
+	tree->leaves = use_slab ? slab_create(sizeof(struct leaf)) : NULL;
+	tree->names = intern_create();
+	tree->num_names = 0;
+	return tree;
+}
+
+static struct art_node* alloc_node(struct tree* tree, int type)
+{
+	struct art_node* n;
+	
+	if (tree->pools[type] != NULL)
+		n = slab_alloc(tree->pools[type]);
+	else
+		n = malloc(node_sizes[type]);
+	memset(n, 0, node_sizes[type]);
+	n->type = type;
+	tree->num_nodes[type]++;
+	return n;
+}
+
+static void release_node(struct tree* tree, struct art_node* n)
+{
+	tree->num_nodes[n->type]--;
+	if (tree->pools[n->type] != NULL)
+		slab_free(tree->pools[n->type], n);
+	else
+		free(n);
+}
+
+static struct leaf* alloc_leaf(struct tree* tree, const char* name)
+{
+	struct leaf* l;
+	
+	if (tree->leaves != NULL)
+		l = slab_alloc(tree->leaves);
+	else
+		l = malloc(sizeof(struct leaf));
+	l->name = name;
+	l->count = 1;
+	return l;
+}
+
+static void release_leaf(struct tree* tree, struct leaf* l)
+{
+	if (tree->leaves != NULL)
+		slab_free(tree->leaves, l);
+	else
+		free(l);
+}
+
+static void destroy_node(struct tree* tree, struct art_node* n)
+{
+	struct node48* n48;
+	int i;
+	
+	if (n == NULL)
+		return;
+	if (IS_LEAF(n))
+	{
+		release_leaf(tree, TO_LEAF(n));
+		return;
+	}
+	
+	switch (n->type)
+	{
+		case NODE4:
+			for (i = 0; i < n->num_children; i++)
+				destroy_node(tree, ((struct node4*)n)->children[i]);
+			break;
+		case NODE16:
+			for (i = 0; i < n->num_children; i++)
+				destroy_node(tree, ((struct node16*)n)->children[i]);
+			break;
+		case NODE48:
+			n48 = (struct node48*)n;
+			for (i = 0; i < 256; i++)
+				if (n48->index[i] != 0)
+					destroy_node(tree, n48->children[n48->index[i] - 1]);
+			break;
+		case NODE256:
+			for (i = 0; i < 256; i++)
+				destroy_node(tree, ((struct node256*)n)->children[i]);
+			break;
+	}
+	release_node(tree, n);
+}
+
+void delete_tree(struct tree* tree)
+{
+	int i;
+	
+	// With slabs every node and leaf goes away at once with the slabs
+	if (tree->leaves == NULL)
+		destroy_node(tree, tree->root);
+	else
+	{
+		for (i = 0; i < 4; i++)
+			slab_destroy(tree->pools[i]);
+		slab_destroy(tree->leaves);
+	}
+	intern_destroy(tree->names);
+	free(tree);
+}
+
+// Bitmask of which of a Node16's keys equal c
+static unsigned node16_match(struct node16* n, unsigned char c)
+{
+#if defined(__SSE2__)
+	__m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)c), _mm_loadu_si128((const __m128i*)n->keys));
+	return (unsigned)_mm_movemask_epi8(cmp) & ((1u << n->n.num_children) - 1);
+#else
+	unsigned mask = 0;
+	int i;
+	for (i = 0; i < n->n.num_children; i++)
+		if (n->keys[i] == c)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+// The link to n's child for character c, or NULL if it doesn't have one
+static struct art_node** find_child(struct art_node* n, unsigned char c)
+{
+	struct node4* n4;
+	struct node48* n48;
+	unsigned mask;
+	int i;
+	
+	switch (n->type)
+	{
+		case NODE4:
+			n4 = (struct node4*)n;
+			for (i = 0; i < n->num_children; i++)
+				if (n4->keys[i] == c)
+					return &n4->children[i];
+			return NULL;
+		case NODE16:
+			mask = node16_match((struct node16*)n, c);
+			if (mask == 0)
+				return NULL;
+			return &((struct node16*)n)->children[__builtin_ctz(mask)];
+		case NODE48:
+			n48 = (struct node48*)n;
+			if (n48->index[c] == 0)
+				return NULL;
+			return &n48->children[n48->index[c] - 1];
+		default:
+			if (((struct node256*)n)->children[c] == NULL)
+				return NULL;
+			return &((struct node256*)n)->children[c];
+	}
+}
+
+// Leaf with the smallest name under n, there always is one
+static struct leaf* minimum(struct art_node* n)
+{
+	struct node48* n48;
+	int i;
+	
+	while (!IS_LEAF(n))
+	{
+		switch (n->type)
+		{
+			case NODE4:
+				n = ((struct node4*)n)->children[0];
+				break;
+			case NODE16:
+				n = ((struct node16*)n)->children[0];
+				break;
+			case NODE48:
+				n48 = (struct node48*)n;
+				for (i = 0; n48->index[i] == 0; i++)
+					;
+				n = n48->children[n48->index[i] - 1];
+				break;
+			default:
+				for (i = 0; ((struct node256*)n)->children[i] == NULL; i++)
+					;
+				n = ((struct node256*)n)->children[i];
+				break;
+		}
+	}
+	return TO_LEAF(n);
+}
+
+// How many of the prefix characters kept in n match key at depth
+static int check_prefix(struct art_node* n, const unsigned char* key, int key_length, int depth)
+{
+	int max = n->prefix_length < MAX_PREFIX ? n->prefix_length : MAX_PREFIX;
+	int i;
+	
+	if (max > key_length - depth)
+		max = key_length - depth;
+	for (i = 0; i < max && n->prefix[i] == key[depth + i]; i++)
+		;
+	return i;
+}
+
+// Where key first differs from n's whole compressed path. Characters
+// past the ones kept in n are read from the smallest name under it.
+static int prefix_mismatch(struct art_node* n, const unsigned char* key, int key_length, int depth)
+{
+	const unsigned char* name;
+	int i, max;
+	
+	i = check_prefix(n, key, key_length, depth);
+	if (i < MAX_PREFIX || n->prefix_length <= MAX_PREFIX)
+		return i;
+	
+	name = (const unsigned char*)minimum(n)->name;
+	max = key_length - depth;
+	if ((int)n->prefix_length < max)
+		max = n->prefix_length;
+	for (; i < max && name[depth + i] == key[depth + i]; i++)
+		;
+	return i;
+}
+
+static void copy_header(struct art_node* dest, struct art_node* src)
+{
+	dest->num_children = src->num_children;
+	dest->prefix_length = src->prefix_length;
+	memcpy(dest->prefix, src->prefix, MAX_PREFIX);
+}
+
+static void add_child(struct tree* tree, struct art_node* n, struct art_node** ref, unsigned char c, struct art_node* child);
+
+static void add_child256(struct node256* n, unsigned char c, struct art_node* child)
+{
+	n->children[c] = child;
+	n->n.num_children++;
+}
+
+static void add_child48(struct tree* tree, struct node48* n, struct art_node** ref, unsigned char c, struct art_node* child)
+{
+	struct node256* bigger;
+	int i;
+	
+	if (n->n.num_children < 48)
+	{
+		for (i = 0; n->children[i] != NULL; i++)
+			;
+		n->children[i] = child;
+		n->index[c] = i + 1;
+		n->n.num_children++;
+		return;
+	}
+	
+	// Case: Full, move everyone into a Node256
+	bigger = (struct node256*)alloc_node(tree, NODE256);
+	for (i = 0; i < 256; i++)
+		if (n->index[i] != 0)
+			bigger->children[i] = n->children[n->index[i] - 1];
+	copy_header(&bigger->n, &n->n);
+	*ref = &bigger->n;
+	release_node(tree, &n->n);
+	add_child256(bigger, c, child);
+}
+
+static void add_child16(struct tree* tree, struct node16* n, struct art_node** ref, unsigned char c, struct art_node* child)
+{
+	struct node48* bigger;
+	unsigned mask;
+	int i;
+	
+	if (n->n.num_children < 16)
+	{
+		// First key bigger than c, which is where c goes. SSE2 only compares
+		// signed bytes, so flip the top bit of both sides to compare unsigned.
+#if defined(__SSE2__)
+		__m128i flip = _mm_set1_epi8((char)0x80);
+		__m128i cmp = _mm_cmplt_epi8(_mm_xor_si128(_mm_set1_epi8((char)c), flip),
+									 _mm_xor_si128(_mm_loadu_si128((const __m128i*)n->keys), flip));
+		mask = (unsigned)_mm_movemask_epi8(cmp) & ((1u << n->n.num_children) - 1);
+#else
+		mask = 0;
+		for (i = 0; i < n->n.num_children; i++)
+			if (c < n->keys[i])
+				mask |= 1u << i;
+#endif
+		i = mask != 0 ? __builtin_ctz(mask) : n->n.num_children;
+		memmove(n->keys + i + 1, n->keys + i, n->n.num_children - i);
+		memmove(n->children + i + 1, n->children + i, (n->n.num_children - i) * sizeof(struct art_node*));
+		n->keys[i] = c;
+		n->children[i] = child;
+		n->n.num_children++;
+		return;
+	}
+	
+	// Case: Full, move everyone into a Node48
+	bigger = (struct node48*)alloc_node(tree, NODE48);
+	memcpy(bigger->children, n->children, 16 * sizeof(struct art_node*));
+	for (i = 0; i < 16; i++)
+		bigger->index[n->keys[i]] = i + 1;
+	copy_header(&bigger->n, &n->n);
+	*ref = &bigger->n;
+	release_node(tree, &n->n);
+	add_child48(tree, bigger, ref, c, child);
+}
+
+static void add_child4(struct tree* tree, struct node4* n, struct art_node** ref, unsigned char c, struct art_node* child)
+{
+	struct node16* bigger;
+	int i;
+	
+	if (n->n.num_children < 4)
+	{
+		for (i = 0; i < n->n.num_children && n->keys[i] < c; i++)
+			;
+		memmove(n->keys + i + 1, n->keys + i, n->n.num_children - i);
+		memmove(n->children + i + 1, n->children + i, (n->n.num_children - i) * sizeof(struct art_node*));
+		n->keys[i] = c;
+		n->children[i] = child;
+		n->n.num_children++;
+		return;
+	}
+	
+	// Case: Full, move everyone into a Node16
+	bigger = (struct node16*)alloc_node(tree, NODE16);
+	memcpy(bigger->children, n->children, 4 * sizeof(struct art_node*));
+	memcpy(bigger->keys, n->keys, 4);
+	copy_header(&bigger->n, &n->n);
+	*ref = &bigger->n;
+	release_node(tree, &n->n);
+	add_child16(tree, bigger, ref, c, child);
+}
+
+// Give n a child for character c, growing n (and updating ref) if it's full
+static void add_child(struct tree* tree, struct art_node* n, struct art_node** ref, unsigned char c, struct art_node* child)
+{
+	switch (n->type)
+	{
+		case NODE4:
+			add_child4(tree, (struct node4*)n, ref, c, child);
+			break;
+		case NODE16:
+			add_child16(tree, (struct node16*)n, ref, c, child);
+			break;
+		case NODE48:
+			add_child48(tree, (struct node48*)n, ref, c, child);
+			break;
+		default:
+			add_child256((struct node256*)n, c, child);
+			break;
+	}
+}
+
+// Insert the interned name (key_length counts its '\0') below the link ref
+static void insert_at(struct tree* tree, struct art_node** ref, const char* name, int key_length, int depth)
+{
+	const unsigned char* key = (const unsigned char*)name;
+	const unsigned char* other;
+	struct art_node* n = *ref;
+	struct art_node* split;
+	struct art_node** child;
+	struct leaf* l;
+	int i, diff;
+	
+	// Case: Empty spot, the name gets a leaf right here
+	if (n == NULL)
+	{
+		*ref = MAKE_LEAF(alloc_leaf(tree, name));
+		return;
+	}
+	
+	// Case: A leaf is in the way. Either it's the same name, or both names
+	//       go under a new Node4 at the first character where they differ.
+	if (IS_LEAF(n))
+	{
+		l = TO_LEAF(n);
+		if (l->name == name)
+		{
+			l->count++;
+			return;
+		}
+	
+		other = (const unsigned char*)l->name;
+		for (i = depth; other[i] == key[i]; i++)
+			;
+		split = alloc_node(tree, NODE4);
+		split->prefix_length = i - depth;
+		memcpy(split->prefix, key + depth, split->prefix_length < MAX_PREFIX ? split->prefix_length : MAX_PREFIX);
+		*ref = split;
+		add_child4(tree, (struct node4*)split, ref, other[i], n);
+		add_child4(tree, (struct node4*)split, ref, key[i], MAKE_LEAF(alloc_leaf(tree, name)));
+		return;
+	}
+	
+	// Case: The name leaves the node's compressed path part way along, so
+	//       the path gets split with a new Node4 where they part ways
+	if (n->prefix_length != 0)
+	{
+		diff = prefix_mismatch(n, key, key_length, depth);
+		if (diff < (int)n->prefix_length)
+		{
+			split = alloc_node(tree, NODE4);
+			split->prefix_length = diff;
+			memcpy(split->prefix, n->prefix, diff < MAX_PREFIX ? diff : MAX_PREFIX);
+			*ref = split;
+	
+			// What's left of n's path after the split character. If n kept
+			// its whole path it can just be shifted, otherwise the characters
+			// have to come from a name under n.
+			if (n->prefix_length <= MAX_PREFIX)
+			{
+				add_child4(tree, (struct node4*)split, ref, n->prefix[diff], n);
+				n->prefix_length -= diff + 1;
+				memmove(n->prefix, n->prefix + diff + 1, n->prefix_length < MAX_PREFIX ? n->prefix_length : MAX_PREFIX);
+			}
+			else
+			{
+				other = (const unsigned char*)minimum(n)->name;
+				add_child4(tree, (struct node4*)split, ref, other[depth + diff], n);
+				n->prefix_length -= diff + 1;
+				memcpy(n->prefix, other + depth + diff + 1, n->prefix_length < MAX_PREFIX ? n->prefix_length : MAX_PREFIX);
+			}
+			add_child4(tree, (struct node4*)split, ref, key[depth + diff], MAKE_LEAF(alloc_leaf(tree, name)));
+			return;
+		}
+		depth += n->prefix_length;
+	}
+	
+	child = find_child(n, key[depth]);
+	if (child != NULL)
+		insert_at(tree, child, name, key_length, depth + 1);
+	else
+		add_child(tree, n, ref, key[depth], MAKE_LEAF(alloc_leaf(tree, name)));
+}
+
+// Insert a name into the tree
+void insert(struct tree* tree, char name[])
+{
+	const char* interned = intern(tree->names, name);
+	
+	insert_at(tree, &tree->root, interned, intern_length(interned) + 1, 0);
+	tree->num_names++;
+}
+
+// Search the tree for a name, returns 1 if it's there
+int find(struct tree* tree, char name[])
+{
+	const unsigned char* key = (const unsigned char*)name;
+	struct art_node* n = tree->root;
+	struct art_node** child;
+	const char* interned;
+	int key_length, depth = 0;
+	
+	// Case: The name was never interned, so no leaf can have it
+	interned = intern_find(tree->names, name);
+	if (interned == NULL)
+		return 0;
+	key_length = intern_length(interned) + 1;
+	
+	while (n != NULL)
+	{
+		if (IS_LEAF(n))
+			return TO_LEAF(n)->name == interned;
+	
+		// Only the kept part of a path gets checked, the leaf we end
+		// up at is compared in full anyway
+		if (n->prefix_length != 0)
+		{
+			if (check_prefix(n, key, key_length, depth) != (n->prefix_length < MAX_PREFIX ? (int)n->prefix_length : MAX_PREFIX))
+				return 0;
+			depth += n->prefix_length;
+		}
+		if (depth >= key_length)
+			return 0;
+	
+		child = find_child(n, key[depth]);
+		n = child != NULL ? *child : NULL;
+		depth++;
+	}
+	return 0;
+}
+
+static void remove_child256(struct tree* tree, struct node256* n, struct art_node** ref, unsigned char c)
+{
+	struct node48* smaller;
+	int i, pos;
+	
+	n->children[c] = NULL;
+	n->n.num_children--;
+	
+	// Shrink a while after the Node48 limit, so a node going back and
+	// forth over it doesn't get copied every time
+	if (n->n.num_children == 37)
+	{
+		smaller = (struct node48*)alloc_node(tree, NODE48);
+		copy_header(&smaller->n, &n->n);
+		pos = 0;
+		for (i = 0; i < 256; i++)
+		{
+			if (n->children[i] != NULL)
+			{
+				smaller->children[pos] = n->children[i];
+				smaller->index[i] = ++pos;
+			}
+		}
+		*ref = &smaller->n;
+		release_node(tree, &n->n);
+	}
+}
+
+static void remove_child48(struct tree* tree, struct node48* n, struct art_node** ref, unsigned char c)
+{
+	struct node16* smaller;
+	int i, pos;
+	
+	n->children[n->index[c] - 1] = NULL;
+	n->index[c] = 0;
+	n->n.num_children--;
+	
+	if (n->n.num_children == 12)
+	{
+		smaller = (struct node16*)alloc_node(tree, NODE16);
+		copy_header(&smaller->n, &n->n);
+		pos = 0;
+		// Going through the characters in order keeps the keys sorted
+		for (i = 0; i < 256; i++)
+		{
+			if (n->index[i] != 0)
+			{
+				smaller->keys[pos] = i;
+				smaller->children[pos] = n->children[n->index[i] - 1];
+				pos++;
+			}
+		}
+		*ref = &smaller->n;
+		release_node(tree, &n->n);
+	}
+}
+
+static void remove_child16(struct tree* tree, struct node16* n, struct art_node** ref, struct art_node** child)
+{
+	struct node4* smaller;
+	int pos = child - n->children;
+	
+	memmove(n->keys + pos, n->keys + pos + 1, n->n.num_children - 1 - pos);
+	memmove(n->children + pos, n->children + pos + 1, (n->n.num_children - 1 - pos) * sizeof(struct art_node*));
+	n->n.num_children--;
+	
+	if (n->n.num_children == 3)
+	{
+		smaller = (struct node4*)alloc_node(tree, NODE4);
+		copy_header(&smaller->n, &n->n);
+		memcpy(smaller->keys, n->keys, 3);
+		memcpy(smaller->children, n->children, 3 * sizeof(struct art_node*));
+		*ref = &smaller->n;
+		release_node(tree, &n->n);
+	}
+}
+
+static void remove_child4(struct tree* tree, struct node4* n, struct art_node** ref, struct art_node** child)
+{
+	struct art_node* only;
+	int pos = child - n->children;
+	int length, sub;
+	
+	memmove(n->keys + pos, n->keys + pos + 1, n->n.num_children - 1 - pos);
+	memmove(n->children + pos, n->children + pos + 1, (n->n.num_children - 1 - pos) * sizeof(struct art_node*));
+	n->n.num_children--;
+	
+	// Case: One child left, so n is just part of a path now. Its path, the
+	//       character of the child and the child's path all become the child's path.
+	if (n->n.num_children == 1)
+	{
+		only = n->children[0];
+		if (!IS_LEAF(only))
+		{
+			length = n->n.prefix_length;
+			if (length < MAX_PREFIX)
+				n->n.prefix[length++] = n->keys[0];
+			if (length < MAX_PREFIX)
+			{
+				sub = only->prefix_length < (uint32_t)(MAX_PREFIX - length) ? (int)only->prefix_length : MAX_PREFIX - length;
+				memcpy(n->n.prefix + length, only->prefix, sub);
+				length += sub;
+			}
+			memcpy(only->prefix, n->n.prefix, length < MAX_PREFIX ? length : MAX_PREFIX);
+			only->prefix_length += n->n.prefix_length + 1;
+		}
+		*ref = only;
+		release_node(tree, &n->n);
+	}
+}
+
+// Take n's child for character c (found at the link child) out of n,
+// shrinking n (and updating ref) once it gets small enough
+static void remove_child(struct tree* tree, struct art_node* n, struct art_node** ref, unsigned char c, struct art_node** child)
+{
+	switch (n->type)
+	{
+		case NODE4:
+			remove_child4(tree, (struct node4*)n, ref, child);
+			break;
+		case NODE16:
+			remove_child16(tree, (struct node16*)n, ref, child);
+			break;
+		case NODE48:
+			remove_child48(tree, (struct node48*)n, ref, c);
+			break;
+		default:
+			remove_child256(tree, (struct node256*)n, ref, c);
+			break;
+	}
+}
+
+// Remove one copy of the interned name from below the link ref, returns 1 if it was there
+static int delete_at(struct tree* tree, struct art_node** ref, const char* name, int key_length, int depth)
+{
+	const unsigned char* key = (const unsigned char*)name;
+	struct art_node* n = *ref;
+	struct art_node** child;
+	struct leaf* l;
+	
+	if (n == NULL)
+		return 0;
+	
+	// Case: The whole tree is a single leaf
+	if (IS_LEAF(n))
+	{
+		l = TO_LEAF(n);
+		if (l->name != name)
+			return 0;
+		if (--l->count == 0)
+		{
+			release_leaf(tree, l);
+			*ref = NULL;
+		}
+		return 1;
+	}
+	
+	if (n->prefix_length != 0)
+	{
+		if (check_prefix(n, key, key_length, depth) != (n->prefix_length < MAX_PREFIX ? (int)n->prefix_length : MAX_PREFIX))
+			return 0;
+		depth += n->prefix_length;
+	}
+	if (depth >= key_length)
+		return 0;
+	
+	child = find_child(n, key[depth]);
+	if (child == NULL)
+		return 0;
+	if (!IS_LEAF(*child))
+		return delete_at(tree, child, name, key_length, depth + 1);
+	
+	// The leaf only leaves the tree once its last copy is gone
+	l = TO_LEAF(*child);
+	if (l->name != name)
+		return 0;
+	if (--l->count == 0)
+	{
+		release_leaf(tree, l);
+		remove_child(tree, n, ref, key[depth], child);
+	}
+	return 1;
+}
+
+// Remove one copy of a name from the tree, returns 1 if it was there
+int delete_node(struct tree* tree, char name[])
+{
+	const char* interned;
+	
+	// Case: The name was never interned, so no leaf can have it
+	interned = intern_find(tree->names, name);
+	if (interned == NULL)
+		return 0;
+	
+	if (!delete_at(tree, &tree->root, interned, intern_length(interned) + 1, 0))
+		return 0;
+	tree->num_names--;
+	return 1;
+}
+
+// Print every name under n in order, repeats and all
+static void print_node(struct art_node* n)
+{
+	struct node48* n48;
+	struct leaf* l;
+	int i;
+	
+	if (n == NULL)
+		return;
+	if (IS_LEAF(n))
+	{
+		l = TO_LEAF(n);
+		for (i = 0; i < l->count; i++)
+			printf("%s ", l->name);
+		return;
+	}
+	
+	switch (n->type)
+	{
+		case NODE4:
+			for (i = 0; i < n->num_children; i++)
+				print_node(((struct node4*)n)->children[i]);
+			break;
+		case NODE16:
+			for (i = 0; i < n->num_children; i++)
+				print_node(((struct node16*)n)->children[i]);
+			break;
+		case NODE48:
+			n48 = (struct node48*)n;
+			for (i = 0; i < 256; i++)
+				if (n48->index[i] != 0)
+					print_node(n48->children[n48->index[i] - 1]);
+			break;
+		default:
+			for (i = 0; i < 256; i++)
+				print_node(((struct node256*)n)->children[i]);
+			break;
+	}
+}
+
+void print_list(struct tree* tree)
+{
+	printf("\n");
+	print_node(tree->root);
+	printf("\n\n");
+}
+
+// Add every word in a file. Unlike the lists the names don't need to be
+// sorted, every insert costs the same. Returns the number of names read,
+// or -1 if the file couldn't be opened.
+int load_file(struct tree* tree, const char* filename)
+{
+	FILE* fp;
+	char name[MAX_LENGTH];
+	int count = 0;
+	
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	
+	while (fscanf(fp, "%99s", name) == 1)
+	{
+		insert(tree, name);
+		count++;
+	}
+	
+	fclose(fp);
+	return count;
+}
+
+void print_stats(struct tree* tree)
+{
+	long bytes = 0;
+	int i;
+	
+	printf("\n%ld names in the tree\n", tree->num_names);
+	for (i = 0; i < 4; i++)
+	{
+		printf("%-8s %8ld nodes (%zu bytes each)\n", node_names[i], tree->num_nodes[i], node_sizes[i]);
+		bytes += tree->num_nodes[i] * node_sizes[i];
+	}
+	printf("Inner nodes take %ld bytes\n", bytes);
+	if (tree->leaves != NULL)
+	{
+		for (i = 0; i < 4; i++)
+			slab_print_stats(tree->pools[i], node_names[i]);
+		slab_print_stats(tree->leaves, "Leaf");
+	}
+	intern_print_stats(tree->names, "Name");
+}
+
+int main(void)
+{
+	int choice, count;
+	char name[MAX_LENGTH];
+	char filename[256];
+	clock_t start;
+	
+	struct tree* tree;
+	tree = create_tree(1);
+	
+	printf("Welcome to the names database!\n");
+	printf("We're happy to store all the names you like.\n");
+	
+	do {
+		printf("What would you like to do?\n");
+		printf("1. Add a name to the list.\n");
+		printf("2. Print the list\n");
+		printf("3. Delete name from the list\n");
+		printf("4. Print allocation stats\n");
+		printf("5. Load names from a file\n");
+		printf("6. Look up a name\n");
+		printf("0. Exit the program\n");
+		scanf("%d", &choice);
+	
+		if (choice == 1)
+		{
+			printf("Please enter the name you wish to add to the list\n");
+			scanf("%99s", name);
+			insert(tree, name);
+		}
+		else if (choice == 2)
+			print_list(tree);
+		else if (choice == 3)
+		{
+			printf("Please enter the name you wish to delete\n");
+			scanf("%99s", name);
+			if (delete_node(tree, name))
+				printf("Succesfully deleted %s from the list!\n", name);
+			else
+				printf("Sorry I could not find %s in the list\n", name);
+		}
+		else if (choice == 4)
+			print_stats(tree);
+		else if (choice == 5)
+		{
+			printf("Please enter the file you wish to load\n");
+			scanf("%255s", filename);
+			start = clock();
+			count = load_file(tree, filename);
+			if (count < 0)
+				printf("Sorry I could not open %s\n", filename);
+			else
+				printf("Loaded %d names in %.3f ms\n", count, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+		}
+		else if (choice == 6)
+		{
+			printf("Please enter the name you wish to look up\n");
+			scanf("%99s", name);
+			if (find(tree, name))
+				printf("%s is in the list!\n", name);
+			else
+				printf("Sorry I could not find %s in the list\n", name);
+		}
+	} while (choice != 0);
+	
+	delete_tree(tree);
+	
+	system("PAUSE");
+	
+	exit(0);
+}
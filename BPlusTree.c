@@ -0,0 +1,705 @@
+/*
+** A B+ tree of integers, an ordered index for sets far too big for a binary tree
+**
+** Every node is NODE_BYTES (4 cache lines) and holds many keys, so the tree is only a
+** few levels tall and every cache line we pull in is full of keys instead of pointers.
+** Inner nodes only hold separator keys to steer searches, all values live in the leaves,
+** and the leaves are linked together left to right so ordered scans just walk the chain.
+** Searching inside a node compares a whole vector of keys at once (SSE2 or AVX2).
+**
+** Like the binary search tree, duplicates are allowed, lookup says whether a value is
+** there and delete_node removes one copy of it.
+**
+** Time Complexity (B is the number of keys per node)
+** Insert:   O(B log_B n)
+** Delete:   O(B log_B n)
+** Search:   O(B log_B n) but only O(log_B n) cache misses
+** Traverse: O(n) by walking the leaves
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Slab.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Every node is this big and starts on a cache line
+#define NODE_BYTES 256
+#define CACHE_LINE 64
+// Keys per node, picked so that each kind of node fills NODE_BYTES exactly
+#define LEAF_KEYS 60
+#define INNER_KEYS 20
+// Nodes (other than the root) never get less than half full
+#define MIN_LEAF_KEYS (LEAF_KEYS / 2)
+#define MIN_INNER_KEYS (INNER_KEYS / 2)
+// Even with minimally full nodes this covers way more keys than fit in an int
+#define MAX_DEPTH 32
+
+// Both kinds of node start with this
+struct bnode {
+	int is_leaf;
+	int count; // Number of keys in the node
+};
+
+struct leaf {
+	struct bnode hdr;
+	int keys[LEAF_KEYS];
+	struct leaf* next; // Leaf to the right, NULL for the last leaf
+};
+
+// Every key in children[i] is <= keys[i] <= every key in children[i + 1]
+struct inner {
+	struct bnode hdr;
+	int keys[INNER_KEYS];
+	struct bnode* children[INNER_KEYS + 1];
+};
+
+struct bptree {
+	struct bnode* root;
+	int height; // Number of levels, 0 for an empty tree
+	int size;   // Number of keys
+	struct slab* pool; // Nodes come from here if the tree opted into a slab
+};
+
+// Walks the values in order by following the leaf chain
+struct cursor {
+	struct bptree* t;
+	struct leaf* leaf;
+	int pos;
+};
+
+struct bptree* create_bptree(int use_slab);
+void insert(struct bptree* t, int value);
+int lookup(struct bptree* t, int value);
+int delete_node(struct bptree* t, int value);
+void free_bptree(struct bptree* t);
+void print_tree(struct bptree* t);
+void print_stats(struct bptree* t);
+struct cursor* create_cursor(struct bptree* t);
+void cursor_begin(struct cursor* c);
+void cursor_seek(struct cursor* c, int key);
+int cursor_next(struct cursor* c, int* value);
+void delete_cursor(struct cursor* c);
+
+// Create an empty tree, with its own slab of nodes if use_slab is set
+struct bptree* create_bptree(int use_slab)
+{
+	struct bptree* t;
+	t = malloc(sizeof(struct bptree));
+	t->root = NULL;
+	t->height = 0;
+	t->size = 0;
+	t->pool = use_slab ? slab_create_aligned(NODE_BYTES, CACHE_LINE) : NULL;
+	return t;
+}
+
+// Allocate a node from the tree's slab, or a cache line aligned malloc
+static void* alloc_node(struct bptree* t, int is_leaf)
+{
+	struct bnode* node;
+
+	if (t->pool != NULL)
+		node = slab_alloc(t->pool);
+	else
+		node = aligned_alloc(CACHE_LINE, NODE_BYTES);
+
+	node->is_leaf = is_leaf;
+	node->count = 0;
+	return node;
+}
+
+// Give a node back to wherever it was allocated from
+static void release_node(struct bptree* t, void* node)
+{
+	if (t->pool != NULL)
+		slab_free(t->pool, node);
+	else
+		free(node);
+}
+
+// Count the keys smaller than value. Keys are sorted, so this is also the
+// position of the first key >= value. Rather than branching on every key
+// we compare a whole vector of keys with value at once and count the hits.
+static int count_less(const int* keys, int count, int value)
+{
+	int i = 0, n = 0;
+
+#if defined(__AVX2__)
+	__m256i v = _mm256_set1_epi32(value);
+	for (; i + 8 <= count; i += 8)
+		n += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(
+			_mm256_cmpgt_epi32(v, _mm256_loadu_si256((const __m256i*)(keys + i))))));
+#elif defined(__SSE2__)
+	__m128i v = _mm_set1_epi32(value);
+	for (; i + 4 <= count; i += 4)
+		n += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(
+			_mm_cmpgt_epi32(v, _mm_loadu_si128((const __m128i*)(keys + i))))));
+#endif
+	for (; i < count; i++)
+		n += keys[i] < value;
+
+	return n;
+}
+
+// Make room at keys[pos] (and children[pos + 1]) of an inner node and put key/child there
+static void inner_insert_at(struct inner* in, int pos, int key, struct bnode* child)
+{
+	memmove(&in->keys[pos + 1], &in->keys[pos], (in->hdr.count - pos) * sizeof(int));
+	memmove(&in->children[pos + 2], &in->children[pos + 1], (in->hdr.count - pos) * sizeof(struct bnode*));
+	in->keys[pos] = key;
+	in->children[pos + 1] = child;
+	in->hdr.count++;
+}
+
+// Remove keys[pos] and children[pos + 1] from an inner node
+static void inner_remove_at(struct inner* in, int pos)
+{
+	memmove(&in->keys[pos], &in->keys[pos + 1], (in->hdr.count - pos - 1) * sizeof(int));
+	memmove(&in->children[pos + 1], &in->children[pos + 2], (in->hdr.count - pos - 1) * sizeof(struct bnode*));
+	in->hdr.count--;
+}
+
+// Insert a value into the tree
+void insert(struct bptree* t, int value)
+{
+	struct inner* path[MAX_DEPTH];
+	int slots[MAX_DEPTH];
+	int tmp_keys[INNER_KEYS + 1 > LEAF_KEYS + 1 ? INNER_KEYS + 1 : LEAF_KEYS + 1];
+	struct bnode* tmp_children[INNER_KEYS + 2];
+	struct bnode* node;
+	struct bnode* new_child;
+	struct leaf* leaf;
+	struct leaf* right;
+	struct inner* in;
+	struct inner* new_inner;
+	struct inner* new_root;
+	int depth, pos, half, separator;
+
+	t->size++;
+
+	// Case: Tree is empty, the first leaf becomes the root
+	if (t->root == NULL)
+	{
+		leaf = alloc_node(t, 1);
+		leaf->keys[0] = value;
+		leaf->hdr.count = 1;
+		leaf->next = NULL;
+		t->root = &leaf->hdr;
+		t->height = 1;
+		return;
+	}
+
+	// Walk down to the leaf, remembering which child we took at each level
+	depth = 0;
+	node = t->root;
+	while (!node->is_leaf)
+	{
+		in = (struct inner*)node;
+		path[depth] = in;
+		slots[depth] = count_less(in->keys, in->hdr.count, value);
+		node = in->children[slots[depth]];
+		depth++;
+	}
+
+	leaf = (struct leaf*)node;
+	pos = count_less(leaf->keys, leaf->hdr.count, value);
+
+	// Case: There is room in the leaf
+	if (leaf->hdr.count < LEAF_KEYS)
+	{
+		memmove(&leaf->keys[pos + 1], &leaf->keys[pos], (leaf->hdr.count - pos) * sizeof(int));
+		leaf->keys[pos] = value;
+		leaf->hdr.count++;
+		return;
+	}
+
+	// Case: Leaf is full, split it in half. The first key of the new right
+	//       leaf gets pushed up to the parent as the separator.
+	memcpy(tmp_keys, leaf->keys, pos * sizeof(int));
+	tmp_keys[pos] = value;
+	memcpy(&tmp_keys[pos + 1], &leaf->keys[pos], (LEAF_KEYS - pos) * sizeof(int));
+
+	half = (LEAF_KEYS + 1) / 2;
+	right = alloc_node(t, 1);
+	memcpy(leaf->keys, tmp_keys, half * sizeof(int));
+	leaf->hdr.count = half;
+	memcpy(right->keys, &tmp_keys[half], (LEAF_KEYS + 1 - half) * sizeof(int));
+	right->hdr.count = LEAF_KEYS + 1 - half;
+	right->next = leaf->next;
+	leaf->next = right;
+
+	separator = right->keys[0];
+	new_child = &right->hdr;
+
+	// Work back up inserting the separator, splitting inner nodes that are full
+	while (depth > 0)
+	{
+		depth--;
+		in = path[depth];
+		pos = slots[depth];
+
+		if (in->hdr.count < INNER_KEYS)
+		{
+			inner_insert_at(in, pos, separator, new_child);
+			return;
+		}
+
+		// Lay out all the keys and children as if the node had room, then
+		// keep the left half, move the middle key up and give the rest away
+		memcpy(tmp_keys, in->keys, pos * sizeof(int));
+		tmp_keys[pos] = separator;
+		memcpy(&tmp_keys[pos + 1], &in->keys[pos], (INNER_KEYS - pos) * sizeof(int));
+		memcpy(tmp_children, in->children, (pos + 1) * sizeof(struct bnode*));
+		tmp_children[pos + 1] = new_child;
+		memcpy(&tmp_children[pos + 2], &in->children[pos + 1], (INNER_KEYS - pos) * sizeof(struct bnode*));
+
+		half = INNER_KEYS / 2;
+		new_inner = alloc_node(t, 0);
+		memcpy(in->keys, tmp_keys, half * sizeof(int));
+		memcpy(in->children, tmp_children, (half + 1) * sizeof(struct bnode*));
+		in->hdr.count = half;
+		memcpy(new_inner->keys, &tmp_keys[half + 1], (INNER_KEYS - half) * sizeof(int));
+		memcpy(new_inner->children, &tmp_children[half + 1], (INNER_KEYS - half + 1) * sizeof(struct bnode*));
+		new_inner->hdr.count = INNER_KEYS - half;
+
+		separator = tmp_keys[half];
+		new_child = &new_inner->hdr;
+	}
+
+	// Case: The root split, so the tree grows a level
+	new_root = alloc_node(t, 0);
+	new_root->keys[0] = separator;
+	new_root->children[0] = t->root;
+	new_root->children[1] = new_child;
+	new_root->hdr.count = 1;
+	t->root = &new_root->hdr;
+	t->height++;
+}
+
+// Find the leaf and position of the first key >= value
+static struct leaf* find_leaf(struct bptree* t, int value, int* pos)
+{
+	struct bnode* node = t->root;
+	struct inner* in;
+	struct leaf* leaf;
+
+	if (node == NULL)
+		return NULL;
+
+	while (!node->is_leaf)
+	{
+		in = (struct inner*)node;
+		node = in->children[count_less(in->keys, in->hdr.count, value)];
+	}
+
+	leaf = (struct leaf*)node;
+	*pos = count_less(leaf->keys, leaf->hdr.count, value);
+
+	// Case: Everything in this leaf is smaller. Since separators can equal the
+	//       keys on either side, the first key >= value starts the next leaf.
+	if (*pos == leaf->hdr.count)
+	{
+		leaf = leaf->next;
+		*pos = 0;
+	}
+
+	return leaf;
+}
+
+// Look up a specific value in the tree
+int lookup(struct bptree* t, int value)
+{
+	struct leaf* leaf;
+	int pos;
+
+	leaf = find_leaf(t, value, &pos);
+	return leaf != NULL && leaf->keys[pos] == value;
+}
+
+// Fix up a node that dropped below half full, with the help of its parent
+// (the child at index i of parent). Borrow a key from a sibling that can
+// spare one, otherwise merge with a sibling. Returns 1 if the parent lost
+// a key to a merge, in which case the parent may now be underfull itself.
+static int fix_underflow(struct bptree* t, struct inner* parent, int i)
+{
+	struct bnode* node = parent->children[i];
+	struct bnode* left = i > 0 ? parent->children[i - 1] : NULL;
+	struct bnode* right = i < parent->hdr.count ? parent->children[i + 1] : NULL;
+	struct leaf* l;
+	struct leaf* r;
+	struct inner* li;
+	struct inner* ri;
+
+	if (node->is_leaf)
+	{
+		// Case: Borrow the largest key of the left sibling
+		if (left != NULL && left->count > MIN_LEAF_KEYS)
+		{
+			l = (struct leaf*)left;
+			r = (struct leaf*)node;
+			memmove(&r->keys[1], &r->keys[0], r->hdr.count * sizeof(int));
+			r->keys[0] = l->keys[--l->hdr.count];
+			r->hdr.count++;
+			parent->keys[i - 1] = r->keys[0];
+			return 0;
+		}
+		// Case: Borrow the smallest key of the right sibling
+		if (right != NULL && right->count > MIN_LEAF_KEYS)
+		{
+			l = (struct leaf*)node;
+			r = (struct leaf*)right;
+			l->keys[l->hdr.count++] = r->keys[0];
+			memmove(&r->keys[0], &r->keys[1], (--r->hdr.count) * sizeof(int));
+			parent->keys[i] = r->keys[0];
+			return 0;
+		}
+
+		// Case: Neither sibling can spare a key, so merge with one of them.
+		//       Always merge the right one of the pair into the left one.
+		if (left != NULL)
+			i--;
+		l = (struct leaf*)parent->children[i];
+		r = (struct leaf*)parent->children[i + 1];
+		memcpy(&l->keys[l->hdr.count], r->keys, r->hdr.count * sizeof(int));
+		l->hdr.count += r->hdr.count;
+		l->next = r->next;
+		release_node(t, r);
+		inner_remove_at(parent, i);
+		return 1;
+	}
+
+	// Case: Borrow through the parent from the left sibling. Its last child
+	//       moves over, the parent's separator comes down in front of it and
+	//       the sibling's last key goes up to be the new separator.
+	if (left != NULL && left->count > MIN_INNER_KEYS)
+	{
+		li = (struct inner*)left;
+		ri = (struct inner*)node;
+		memmove(&ri->keys[1], &ri->keys[0], ri->hdr.count * sizeof(int));
+		memmove(&ri->children[1], &ri->children[0], (ri->hdr.count + 1) * sizeof(struct bnode*));
+		ri->keys[0] = parent->keys[i - 1];
+		ri->children[0] = li->children[li->hdr.count];
+		ri->hdr.count++;
+		parent->keys[i - 1] = li->keys[--li->hdr.count];
+		return 0;
+	}
+	// Case: Borrow through the parent from the right sibling, mirror image
+	if (right != NULL && right->count > MIN_INNER_KEYS)
+	{
+		li = (struct inner*)node;
+		ri = (struct inner*)right;
+		li->keys[li->hdr.count] = parent->keys[i];
+		li->children[li->hdr.count + 1] = ri->children[0];
+		li->hdr.count++;
+		parent->keys[i] = ri->keys[0];
+		memmove(&ri->keys[0], &ri->keys[1], (ri->hdr.count - 1) * sizeof(int));
+		memmove(&ri->children[0], &ri->children[1], ri->hdr.count * sizeof(struct bnode*));
+		ri->hdr.count--;
+		return 0;
+	}
+
+	// Case: Merge the right one of the pair into the left one, pulling
+	//       the parent's separator down between them
+	if (left != NULL)
+		i--;
+	li = (struct inner*)parent->children[i];
+	ri = (struct inner*)parent->children[i + 1];
+	li->keys[li->hdr.count] = parent->keys[i];
+	memcpy(&li->keys[li->hdr.count + 1], ri->keys, ri->hdr.count * sizeof(int));
+	memcpy(&li->children[li->hdr.count + 1], ri->children, (ri->hdr.count + 1) * sizeof(struct bnode*));
+	li->hdr.count += ri->hdr.count + 1;
+	release_node(t, ri);
+	inner_remove_at(parent, i);
+	return 1;
+}
+
+// Delete one copy of a value from the tree
+int delete_node(struct bptree* t, int value)
+{
+	struct inner* path[MAX_DEPTH];
+	int slots[MAX_DEPTH];
+	struct bnode* node;
+	struct inner* in;
+	struct leaf* leaf;
+	int depth, pos, min;
+
+	if (t->root == NULL)
+		return 0;
+
+	// Walk down to the leaf, remembering which child we took at each level
+	depth = 0;
+	node = t->root;
+	while (!node->is_leaf)
+	{
+		in = (struct inner*)node;
+		path[depth] = in;
+		slots[depth] = count_less(in->keys, in->hdr.count, value);
+		node = in->children[slots[depth]];
+		depth++;
+	}
+
+	leaf = (struct leaf*)node;
+	pos = count_less(leaf->keys, leaf->hdr.count, value);
+
+	// Case: The value can only be the first key of the next leaf. Move the
+	//       path over to it: back up to the first level where we didn't take
+	//       the last child, take the next child and go down its left edge.
+	if (pos == leaf->hdr.count)
+	{
+		while (depth > 0 && slots[depth - 1] == path[depth - 1]->hdr.count)
+			depth--;
+		if (depth == 0)
+			return 0;
+
+		node = path[depth - 1]->children[++slots[depth - 1]];
+		while (!node->is_leaf)
+		{
+			path[depth] = (struct inner*)node;
+			slots[depth] = 0;
+			node = path[depth]->children[0];
+			depth++;
+		}
+		leaf = (struct leaf*)node;
+		pos = 0;
+	}
+
+	if (leaf->keys[pos] != value)
+		return 0;
+
+	memmove(&leaf->keys[pos], &leaf->keys[pos + 1], (leaf->hdr.count - pos - 1) * sizeof(int));
+	leaf->hdr.count--;
+	t->size--;
+
+	// Work back up fixing nodes that are now less than half full
+	node = &leaf->hdr;
+	while (depth > 0)
+	{
+		min = node->is_leaf ? MIN_LEAF_KEYS : MIN_INNER_KEYS;
+		if (node->count >= min)
+			break;
+
+		depth--;
+		if (!fix_underflow(t, path[depth], slots[depth]))
+			break;
+		node = &path[depth]->hdr;
+	}
+
+	// Case: The root is an inner node with a single child left, so the tree
+	//       shrinks a level. Or the last key is gone and the tree is empty.
+	if (!t->root->is_leaf && t->root->count == 0)
+	{
+		node = t->root;
+		t->root = ((struct inner*)node)->children[0];
+		release_node(t, node);
+		t->height--;
+	}
+	else if (t->root->is_leaf && t->root->count == 0)
+	{
+		release_node(t, t->root);
+		t->root = NULL;
+		t->height = 0;
+	}
+
+	return 1;
+}
+
+// Free every node, going depth first with an explicit path
+static void free_nodes(struct bptree* t)
+{
+	struct inner* path[MAX_DEPTH];
+	int slots[MAX_DEPTH];
+	struct bnode* node = t->root;
+	int depth = 0;
+
+	while (node != NULL)
+	{
+		// Go down the leftmost child not freed yet
+		while (!node->is_leaf)
+		{
+			path[depth] = (struct inner*)node;
+			slots[depth] = 0;
+			node = path[depth]->children[0];
+			depth++;
+		}
+		free(node);
+		node = NULL;
+
+		// Back up freeing inner nodes whose children are all gone
+		while (depth > 0 && slots[depth - 1] == path[depth - 1]->hdr.count)
+			free(path[--depth]);
+		if (depth > 0)
+			node = path[depth - 1]->children[++slots[depth - 1]];
+	}
+}
+
+// Free the tree along with all of its nodes
+void free_bptree(struct bptree* t)
+{
+	// With a slab every node goes away at once with the slab
+	if (t->pool != NULL)
+		slab_destroy(t->pool);
+	else
+		free_nodes(t);
+
+	free(t);
+}
+
+// Create a cursor for walking the values in order, positioned at the smallest one
+struct cursor* create_cursor(struct bptree* t)
+{
+	struct cursor* c;
+	c = malloc(sizeof(struct cursor));
+	c->t = t;
+	cursor_begin(c);
+	return c;
+}
+
+// Move the cursor back to the smallest value in the tree
+void cursor_begin(struct cursor* c)
+{
+	struct bnode* node = c->t->root;
+
+	while (node != NULL && !node->is_leaf)
+		node = ((struct inner*)node)->children[0];
+	c->leaf = (struct leaf*)node;
+	c->pos = 0;
+}
+
+// Move the cursor so the next value it returns is the first one >= key
+void cursor_seek(struct cursor* c, int key)
+{
+	c->leaf = find_leaf(c->t, key, &c->pos);
+}
+
+// Store the next value in order in *value and return 1, or return 0 at the end
+int cursor_next(struct cursor* c, int* value)
+{
+	// Skip past the end of the current leaf (or an empty root leaf)
+	while (c->leaf != NULL && c->pos >= c->leaf->hdr.count)
+	{
+		c->leaf = c->leaf->next;
+		c->pos = 0;
+	}
+
+	if (c->leaf == NULL)
+		return 0;
+
+	*value = c->leaf->keys[c->pos++];
+	return 1;
+}
+
+void delete_cursor(struct cursor* c)
+{
+	free(c);
+}
+
+// Print every value in order by walking the leaf chain
+void print_tree(struct bptree* t)
+{
+	struct cursor* c;
+	int value;
+
+	c = create_cursor(t);
+	while (cursor_next(c, &value))
+		printf("%d ", value);
+	printf("\n");
+	delete_cursor(c);
+}
+
+// Print the shape of the tree and how full its leaves are
+void print_stats(struct bptree* t)
+{
+	struct bnode* node = t->root;
+	struct leaf* leaf;
+	int leaves = 0;
+
+	while (node != NULL && !node->is_leaf)
+		node = ((struct inner*)node)->children[0];
+	for (leaf = (struct leaf*)node; leaf != NULL; leaf = leaf->next)
+		leaves++;
+
+	printf("\n%d values, height %d, %d leaves", t->size, t->height, leaves);
+	if (leaves > 0)
+		printf(" (%.0f%% full)", 100.0 * t->size / ((double)leaves * LEAF_KEYS));
+	printf("\n\n");
+}
+
+int main()
+{
+	struct bptree* tree = create_bptree(1);
+	struct cursor* cursor;
+	int choice, value, high, i;
+
+	do
+	{
+		printf("Make a choice:\n");
+		printf("1. Insert\n");
+		printf("2. Lookup\n");
+		printf("3. Delete\n");
+		printf("4. Print all elements\n");
+		printf("5. Print allocation stats\n");
+		printf("6. Print tree stats\n");
+		printf("7. Print values in a range\n");
+		printf("8. Insert a range of values\n");
+		printf("0. Quit\n");
+		scanf("%d", &choice);
+		if (choice == 1)
+		{
+			printf("What value do you want to insert?\n");
+			scanf("%d", &value);
+			insert(tree, value);
+		}
+		else if (choice == 2)
+		{
+			printf("What value do you want to lookup?\n");
+			scanf("%d", &value);
+			if (lookup(tree, value))
+				printf("Found it\n");
+			else
+				printf("Didn't find it\n");
+		}
+		else if (choice == 3)
+		{
+			printf("What value do you want to delete?\n");
+			scanf("%d", &value);
+			if (delete_node(tree, value))
+				printf("DELETED\n");
+			else
+				printf("That value doesn't exist!\n");
+		}
+		else if (choice == 4)
+			print_tree(tree);
+		else if (choice == 5)
+			slab_print_stats(tree->pool, "Node");
+		else if (choice == 6)
+			print_stats(tree);
+		else if (choice == 7)
+		{
+			printf("What range of values do you want, low and high separated by a space?\n");
+			scanf("%d %d", &value, &high);
+			cursor = create_cursor(tree);
+			cursor_seek(cursor, value);
+			while (cursor_next(cursor, &i) && i <= high)
+				printf("%d ", i);
+			printf("\n");
+			delete_cursor(cursor);
+		}
+		else if (choice == 8)
+		{
+			printf("What range of values do you want to insert, low and high separated by a space?\n");
+			scanf("%d %d", &value, &high);
+			for (i = value; i <= high; i++)
+				insert(tree, i);
+		}
+	} while (choice != 0);
+
+	free_bptree(tree);
+
+	system("PAUSE");
+	exit(0);
+}
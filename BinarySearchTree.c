@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Slab.h"
 /*
 ** Author: Stephen Sheldon 3/8/2019
 **
@@ -11,168 +14,855 @@
 ** Traverse: O(n) Depth first traversal
 ** Search:   O(h) in general or O(n) (Worst case)
 **
+** Nothing here recurses. Inserts, deletes and lookups walk down with a pointer to
+** the link they're on, and traversals keep an explicit stack that only holds one
+** path (so at most h nodes). A cursor walks the tree in order one node at a time,
+** starting from the smallest value or from the first value >= some key, which is
+** handy for range scans.
+**
+** A tree can also be created balanced, in which case it is kept as an AVL tree:
+** every node remembers its height and after an insert or delete any node whose
+** subtrees differ in height by more than one gets rotated back into shape.
+** That keeps h at O(log n), so insert, delete and search are O(log n) worst case.
+** Run the program with "avl" to get a balanced tree.
+**
+** For read mostly sets a tree can be frozen into one array laid out in Eytzinger
+** (breadth first) order. Searching it is branch free and prefetches a few levels
+** ahead, so it takes far fewer cache misses than chasing node pointers. The frozen
+** copy can't be updated, instead thaw it back into a tree, update, and freeze again.
+**
+** Loading values that are already sorted one insert at a time gives an unbalanced
+** tree that is just a linked list, and O(n^2) work. insert_sorted takes a whole
+** sorted batch and builds a perfectly balanced tree out of it in O(n) instead.
+**
 */
 
 struct node {
 	int data;
 	struct node* left;
 	struct node* right;
+	int height; // Only kept up to date in balanced trees
 };
 
-int delete_node(struct node** root, int value);
-struct node* remove_largest_node(struct node** root);
-void insert(struct node** root, int value);
+struct tree {
+	struct node* root;
+	int balanced;      // Keep the tree balanced (AVL) on insert and delete
+	struct slab* pool; // Nodes come from here if the tree opted into a slab
+};
+
+// Growable stack of nodes used in place of recursion. It only ever
+// holds one path through the tree, so it is bounded by the height.
+struct node_stack {
+	struct node** items;
+	int size;
+	int capacity;
+};
+
+// Walks a tree in order one node at a time. The stack holds the nodes
+// still to be visited whose left subtrees we are somewhere inside of.
+struct cursor {
+	struct tree* t;
+	struct node_stack stack;
+};
+
+// A read only copy of a tree's values in one contiguous array, laid out
+// in Eytzinger (breadth first) order: the root is at index 1 and the
+// children of index k are at 2k and 2k+1.
+struct frozen_tree {
+	int* keys;
+	int n;
+};
+
+// AVL trees are never taller than about 1.44 * log2(n), so this is plenty
+#define MAX_AVL_HEIGHT 64
+
+struct tree* create_tree(int balanced, int use_slab);
+int delete_node(struct tree* t, int value);
+struct node* remove_largest_node(struct tree* t, struct node** root);
+void insert(struct tree* t, int value);
 int lookup(struct node* root, int value);
-void free_tree(struct node* root);
+void free_tree(struct tree* t);
 void in_order(struct node* root);
 void pre_order(struct node* root);
 void post_order(struct node* root);
+int tree_height(struct node* root);
+struct cursor* create_cursor(struct tree* t);
+void cursor_begin(struct cursor* c);
+void cursor_seek(struct cursor* c, int key);
+struct node* cursor_next(struct cursor* c);
+void delete_cursor(struct cursor* c);
+struct frozen_tree* freeze_tree(struct tree* t);
+int frozen_lookup(struct frozen_tree* f, int value);
+struct tree* thaw_tree(struct frozen_tree* f, int balanced, int use_slab);
+void delete_frozen_tree(struct frozen_tree* f);
+void benchmark_frozen(struct tree* t, int count);
+void insert_sorted(struct tree* t, const int values[], int count);
+int load_file(struct tree* t, const char* filename);
+
+// Create an empty tree, balanced if balanced is set and with
+// its own slab of nodes if use_slab is set
+struct tree* create_tree(int balanced, int use_slab)
+{
+	struct tree* t;
+	t = malloc(sizeof(struct tree));
+	t->root = NULL;
+	t->balanced = balanced;
+	t->pool = use_slab ? slab_create(sizeof(struct node)) : NULL;
+	return t;
+}
+
+// Allocate a node from the tree's slab, or malloc if it doesn't have one
+static struct node* alloc_node(struct tree* t)
+{
+	if (t->pool != NULL)
+		return slab_alloc(t->pool);
+	return malloc(sizeof(struct node));
+}
+
+// Give a node back to wherever it was allocated from
+static void release_node(struct tree* t, struct node* node)
+{
+	if (t->pool != NULL)
+		slab_free(t->pool, node);
+	else
+		free(node);
+}
+
+// Height of a node in a balanced tree, an empty subtree has height 0
+static int height(struct node* node)
+{
+	return node == NULL ? 0 : node->height;
+}
+
+static void update_height(struct node* node)
+{
+	int left = height(node->left);
+	int right = height(node->right);
+	node->height = (left > right ? left : right) + 1;
+}
+
+// Rotate the subtree at root to the right, its left child becomes the new root
+static void rotate_right(struct node** root)
+{
+	struct node* pivot = (*root)->left;
+	
+	(*root)->left = pivot->right;
+	pivot->right = *root;
+	update_height(*root);
+	update_height(pivot);
+	*root = pivot;
+}
+
+// Rotate the subtree at root to the left, its right child becomes the new root
+static void rotate_left(struct node** root)
+{
+	struct node* pivot = (*root)->right;
+	
+	(*root)->right = pivot->left;
+	pivot->left = *root;
+	update_height(*root);
+	update_height(pivot);
+	*root = pivot;
+}
+
+// Fix up the height of root after one of its subtrees changed, and rotate
+// if the subtrees now differ in height by more than one
+static void rebalance(struct node** root)
+{
+	int balance;
+	
+	update_height(*root);
+	balance = height((*root)->left) - height((*root)->right);
+	
+	// Case: Left heavy. If the extra height is in the left child's right
+	//       subtree we first have to rotate it over to the left side.
+	if (balance > 1)
+	{
+		if (height((*root)->left->left) < height((*root)->left->right))
+			rotate_left(&(*root)->left);
+		rotate_right(root);
+	}
+	// Case: Right heavy, mirror image of the above
+	else if (balance < -1)
+	{
+		if (height((*root)->right->right) < height((*root)->right->left))
+			rotate_right(&(*root)->right);
+		rotate_left(root);
+	}
+}
 
 // Insert a value into the tree
-void insert(struct node** root, int value)
+void insert(struct tree* t, int value)
 {
+	struct node** path[MAX_AVL_HEIGHT];
+	struct node** link;
 	struct node* new_node;
+	int depth = 0;
 	
-	// Base case: we've hit the bottom of the tree so insert node
-	if (*root == NULL)
+	// Walk down to the empty spot the value belongs in. Balanced trees
+	// remember the way down so they can fix things up on the way back.
+	link = &t->root;
+	while (*link != NULL)
 	{
-		new_node = malloc(sizeof(struct node));
-		new_node->data = value;
-		new_node->left = new_node->right = NULL;
-		*root = new_node;
-		return;
+		if (t->balanced)
+			path[depth++] = link;
+		
+		// Go left if the value is smaller, equal values go right
+		if (value < (*link)->data)
+			link = &(*link)->left;
+		else
+			link = &(*link)->right;
 	}
 	
-	// Go left if the root is greater or equal to value to insert
-	if (value < (*root)->data)
-		insert(&((*root)->left), value);
-	else
-		insert(&((*root)->right), value);
+	new_node = alloc_node(t);
+	new_node->data = value;
+	new_node->left = new_node->right = NULL;
+	new_node->height = 1;
+	*link = new_node;
+	
+	while (depth > 0)
+		rebalance(path[--depth]);
 }
 
 // Delete a specific node in the tree by value
-int delete_node(struct node** root, int value)
+int delete_node(struct tree* t, int value)
 {
+	struct node** path[MAX_AVL_HEIGHT];
+	struct node** link;
 	struct node* temp;
+	int depth = 0;
 	
-	// Base case: Node could not be found
-	if (*root == NULL)
-		return 0;
-		
-	// Base case: Found the node
-	if ((*root)->data == value)
+	// Find the link pointing at the node holding value
+	link = &t->root;
+	while (*link != NULL && (*link)->data != value)
 	{
-		temp = *root;
+		if (t->balanced)
+			path[depth++] = link;
 		
-		// Case: Node has no children
-		if ((*root)->left == NULL && (*root)->right == NULL)
-			*root = NULL;
-		// Case: Node with only right child
-		else if ((*root)->left == NULL && (*root)->right != NULL)
-			*root = (*root)->right;
-		// Case: Node with only left child
-		else if ((*root)->left != NULL && (*root)->right == NULL)
-			*root = (*root)->left;
-		// Case: Node with two children
+		if ((*link)->data > value)
+			link = &(*link)->left;
 		else
-		{
-			*root = remove_largest_node(&(*root)->left);
-			(*root)->left = temp->left;
-			(*root)->right = temp->right;
-		}
-		
-		free(temp);
-		return 1;
+			link = &(*link)->right;
 	}
 	
-	// If we haven't found the value then we need
-	// to keep recursively cycling through tree
-	if ((*root)->data > value)
-		delete_node(&((*root)->left), value);
+	// Case: Node could not be found
+	if (*link == NULL)
+		return 0;
+	
+	temp = *link;
+	
+	// Case: Node has no children
+	if (temp->left == NULL && temp->right == NULL)
+		*link = NULL;
+	// Case: Node with only right child
+	else if (temp->left == NULL && temp->right != NULL)
+		*link = temp->right;
+	// Case: Node with only left child
+	else if (temp->left != NULL && temp->right == NULL)
+		*link = temp->left;
+	// Case: Node with two children
 	else
-		delete_node(&((*root)->right), value);
+	{
+		*link = remove_largest_node(t, &temp->left);
+		(*link)->left = temp->left;
+		(*link)->right = temp->right;
+		if (t->balanced)
+			rebalance(link);
+	}
+	
+	release_node(t, temp);
+	
+	while (depth > 0)
+		rebalance(path[--depth]);
+	return 1;
 }
 
 // Remove the largest node in the tree
-struct node* remove_largest_node(struct node** root)
+struct node* remove_largest_node(struct tree* t, struct node** root)
 {
+	struct node** path[MAX_AVL_HEIGHT];
 	struct node* temp;
+	int depth = 0;
 	
-	// Base case: Found the largest node
-	if ((*root)->right == NULL)
+	// The largest node is at the end of the right spine
+	while ((*root)->right != NULL)
 	{
-		temp = *root;
-		*root = (*root)->left;
-		return temp;
+		if (t->balanced)
+			path[depth++] = root;
+		root = &(*root)->right;
 	}
 	
-	// Otherwise recursive case
-	return remove_largest_node(&(*root)->right);
+	temp = *root;
+	*root = (*root)->left;
+	
+	// Rebalance the spine from the bottom back up
+	while (depth > 0)
+		rebalance(path[--depth]);
+	return temp;
 }
 
 // Look up a specific value in the tree
 int lookup(struct node* root, int value)
 {
-	if (root == NULL)
-		return 0;
-		
-	if (root->data < value)
-		lookup(root->left, value);
-	else if (root->data > value)
-		lookup(root->right, value);
-	else if (root->data == value)
-		return 1;
+	while (root != NULL)
+	{
+		if (value < root->data)
+			root = root->left;
+		else if (value > root->data)
+			root = root->right;
+		else
+			return 1;
+	}
+	
+	return 0;
 }
 
-// Post-order traversal to free memory
-void free_tree(struct node* root)
+// Free every node by rotating left children up until there are none,
+// at which point the root can be freed and we move to its right child.
+// This needs no stack at all no matter how tall the tree is.
+static void free_nodes(struct node* root)
 {	
-	if (root == NULL)
+	struct node* temp;
+	
+	while (root != NULL)
+	{
+		if (root->left != NULL)
+		{
+			temp = root->left;
+			root->left = temp->right;
+			temp->right = root;
+			root = temp;
+		}
+		else
+		{
+			temp = root;
+			root = root->right;
+			free(temp);
+		}
+	}
+}
+
+// Free the tree along with all of its nodes
+void free_tree(struct tree* t)
+{
+	// With a slab every node goes away at once with the slab
+	if (t->pool != NULL)
+		slab_destroy(t->pool);
+	else
+		free_nodes(t->root);
+	
+	free(t);
+}
+
+// Push a node onto a traversal stack, doubling its size when full
+static void stack_push(struct node_stack* s, struct node* node)
+{
+	if (s->size == s->capacity)
+	{
+		s->capacity = s->capacity == 0 ? 16 : s->capacity * 2;
+		s->items = realloc(s->items, s->capacity * sizeof(struct node*));
+	}
+	s->items[s->size++] = node;
+}
+
+static struct node* stack_pop(struct node_stack* s)
+{
+	return s->items[--s->size];
+}
+
+// Push node and then its whole chain of left children
+static void push_left_spine(struct node_stack* s, struct node* node)
+{
+	while (node != NULL)
+	{
+		stack_push(s, node);
+		node = node->left;
+	}
+}
+
+// Create a cursor for walking the tree in order, positioned at the smallest value
+struct cursor* create_cursor(struct tree* t)
+{
+	struct cursor* c;
+	c = malloc(sizeof(struct cursor));
+	c->t = t;
+	c->stack.items = NULL;
+	c->stack.size = 0;
+	c->stack.capacity = 0;
+	cursor_begin(c);
+	return c;
+}
+
+// Move the cursor back to the smallest value in the tree
+void cursor_begin(struct cursor* c)
+{
+	c->stack.size = 0;
+	push_left_spine(&c->stack, c->t->root);
+}
+
+// Move the cursor so the next value it returns is the first one >= key.
+// Every node >= key we pass on the way down is still to be visited, the
+// ones < key (and their left subtrees) are skipped entirely.
+void cursor_seek(struct cursor* c, int key)
+{
+	struct node* node;
+	
+	c->stack.size = 0;
+	node = c->t->root;
+	while (node != NULL)
+	{
+		if (node->data >= key)
+		{
+			stack_push(&c->stack, node);
+			node = node->left;
+		}
+		else
+			node = node->right;
+	}
+}
+
+// Return the next node in order, or NULL once we've walked off the end
+struct node* cursor_next(struct cursor* c)
+{
+	struct node* node;
+	
+	if (c->stack.size == 0)
+		return NULL;
+	
+	// The top of the stack is the next node, and whatever comes after it
+	// starts with the smallest node of its right subtree
+	node = stack_pop(&c->stack);
+	push_left_spine(&c->stack, node->right);
+	return node;
+}
+
+void delete_cursor(struct cursor* c)
+{
+	free(c->stack.items);
+	free(c);
+}
+
+// Link nodes[0 .. count-1], which are in sorted order, into a perfectly
+// balanced tree and return its root. The middle node of every range becomes
+// the root of that range, so the two sides of any node differ in size by at
+// most one. Pending ranges go on a small stack rather than recursing.
+static struct node* link_balanced(struct node** nodes, int count)
+{
+	struct {
+		int low, high;
+		struct node** link;
+	} stack[2 * MAX_AVL_HEIGHT];
+	struct node* root;
+	struct node* node;
+	int size = 0, low, high, mid;
+	
+	stack[size].low = 0;
+	stack[size].high = count - 1;
+	stack[size].link = &root;
+	size++;
+	
+	while (size > 0)
+	{
+		size--;
+		low = stack[size].low;
+		high = stack[size].high;
+		if (low > high)
+		{
+			*stack[size].link = NULL;
+			continue;
+		}
+		
+		mid = low + (high - low) / 2;
+		node = nodes[mid];
+		*stack[size].link = node;
+		// A range of m nodes built this way is exactly as tall as m has bits
+		node->height = 32 - __builtin_clz(high - low + 1);
+		
+		stack[size].low = mid + 1;
+		stack[size].high = high;
+		stack[size].link = &node->right;
+		size++;
+		stack[size].low = low;
+		stack[size].high = mid - 1;
+		stack[size].link = &node->left;
+		size++;
+	}
+	
+	return root;
+}
+
+static int compare_ints(const void* a, const void* b)
+{
+	int x = *(const int*)a, y = *(const int*)b;
+	return (x > y) - (x < y);
+}
+
+// Add count values at once. The values should already be sorted, in which
+// case the whole thing is O(n + count): the tree's nodes are walked in order
+// and merged with the new values, then everything is relinked into one
+// perfectly balanced tree. Much better than count inserts, which degenerate
+// into a linked list for sorted input if the tree isn't balanced.
+// Unsorted values still work, they just get sorted first.
+void insert_sorted(struct tree* t, const int values[], int count)
+{
+	struct cursor* c;
+	struct node** nodes;
+	struct node* node;
+	int* sorted = NULL;
+	int i, n = 0, total = 0;
+	
+	if (count <= 0)
 		return;
 	
-	free_tree(root->right);
-	free(root);
-	free_tree(root->left);	
+	for (i = 1; i < count && values[i - 1] <= values[i]; i++)
+		;
+	if (i < count)
+	{
+		sorted = malloc(count * sizeof(int));
+		memcpy(sorted, values, count * sizeof(int));
+		qsort(sorted, count, sizeof(int), compare_ints);
+		values = sorted;
+	}
+	
+	c = create_cursor(t);
+	while (cursor_next(c) != NULL)
+		n++;
+	nodes = malloc(((size_t)n + count) * sizeof(struct node*));
+	
+	// Merge the existing nodes with new nodes for the values, new values go
+	// after existing equal ones the same way insert puts them to the right
+	cursor_begin(c);
+	node = cursor_next(c);
+	for (i = 0; i < count; i++)
+	{
+		while (node != NULL && node->data <= values[i])
+		{
+			nodes[total++] = node;
+			node = cursor_next(c);
+		}
+		nodes[total] = alloc_node(t);
+		nodes[total++]->data = values[i];
+	}
+	while (node != NULL)
+	{
+		nodes[total++] = node;
+		node = cursor_next(c);
+	}
+	
+	t->root = link_balanced(nodes, total);
+	
+	delete_cursor(c);
+	free(nodes);
+	free(sorted);
+}
+
+// Read whitespace separated values from a file and add them with insert_sorted.
+// Returns the number of values read, or -1 if the file couldn't be opened.
+int load_file(struct tree* t, const char* filename)
+{
+	FILE* fp;
+	int* values = NULL;
+	int count = 0, capacity = 0, value;
+	
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	
+	while (fscanf(fp, "%d", &value) == 1)
+	{
+		if (count == capacity)
+		{
+			capacity = capacity == 0 ? 1024 : capacity * 2;
+			values = realloc(values, capacity * sizeof(int));
+		}
+		values[count++] = value;
+	}
+	fclose(fp);
+	
+	insert_sorted(t, values, count);
+	free(values);
+	return count;
 }
 
 // In-order traversal
 void in_order(struct node* root)
 {
-	if (root == NULL)
-		return;
+	struct node_stack s = { NULL, 0, 0 };
 	
-	in_order(root->left);
-	printf("%d ", root->data);
-	in_order(root->right);
+	push_left_spine(&s, root);
+	while (s.size > 0)
+	{
+		root = stack_pop(&s);
+		printf("%d ", root->data);
+		push_left_spine(&s, root->right);
+	}
+	
+	free(s.items);
 }
 
 // Pre-order traversal
 void pre_order(struct node* root)
 {
-	if (root == NULL)
-		return;
+	struct node_stack s = { NULL, 0, 0 };
+	
+	if (root != NULL)
+		stack_push(&s, root);
+	while (s.size > 0)
+	{
+		root = stack_pop(&s);
+		printf("%d ", root->data);
+		// Push right first so the left subtree comes off the stack first
+		if (root->right != NULL)
+			stack_push(&s, root->right);
+		if (root->left != NULL)
+			stack_push(&s, root->left);
+	}
+	
+	free(s.items);
+}
+
+// Number of levels in the tree, computed a level at a time
+// so it works whether or not the tree is balanced
+int tree_height(struct node* root)
+{
+	struct node_stack level = { NULL, 0, 0 };
+	struct node_stack next = { NULL, 0, 0 };
+	struct node_stack temp;
+	int height = 0;
+	
+	if (root != NULL)
+		stack_push(&level, root);
+	while (level.size > 0)
+	{
+		height++;
+		while (level.size > 0)
+		{
+			root = stack_pop(&level);
+			if (root->left != NULL)
+				stack_push(&next, root->left);
+			if (root->right != NULL)
+				stack_push(&next, root->right);
+		}
+		temp = level;
+		level = next;
+		next = temp;
+	}
 	
-	printf("%d ", root->data);
-	pre_order(root->left);
-	pre_order(root->right);
+	free(level.items);
+	free(next.items);
+	return height;
 }
 
 // Post-order traversal
 void post_order(struct node* root)
 {
-	if (root == NULL)
-		return;
+	struct node_stack s = { NULL, 0, 0 };
+	struct node* last_printed = NULL;
+	struct node* top;
+	
+	push_left_spine(&s, root);
+	while (s.size > 0)
+	{
+		top = s.items[s.size - 1];
 		
-	post_order(root->left);
-	post_order(root->right);
-	printf("%d ", root->data);
+		// Case: The right subtree still needs printing before this node
+		if (top->right != NULL && top->right != last_printed)
+			push_left_spine(&s, top->right);
+		else
+		{
+			printf("%d ", top->data);
+			last_printed = stack_pop(&s);
+		}
+	}
+	
+	free(s.items);
+}
+
+// Step from index k to the next index of the implicit tree (children of k
+// are 2k and 2k+1) in sorted order. Returns 0 once we walk off the end.
+static int eytzinger_next(int k, int n)
+{
+	// Case: There is a right subtree, go to its smallest node
+	if (2 * k + 1 <= n)
+	{
+		k = 2 * k + 1;
+		while (2 * k <= n)
+			k = 2 * k;
+		return k;
+	}
+	
+	// Otherwise go up until we come up out of a left subtree
+	while (k & 1)
+		k >>= 1;
+	return k >> 1;
+}
+
+// Smallest index of the implicit tree, at the end of its left spine
+static int eytzinger_first(int n)
+{
+	int k = 1;
+	
+	if (n == 0)
+		return 0;
+	while (2 * k <= n)
+		k = 2 * k;
+	return k;
 }
 
+// Snapshot the tree into one contiguous array of keys in Eytzinger order
+struct frozen_tree* freeze_tree(struct tree* t)
+{
+	struct frozen_tree* f;
+	struct cursor* c;
+	struct node* node;
+	size_t bytes;
+	int k;
+	
+	f = malloc(sizeof(struct frozen_tree));
+	
+	// Count the nodes first so we know how big the array has to be
+	f->n = 0;
+	c = create_cursor(t);
+	while (cursor_next(c) != NULL)
+		f->n++;
+	
+	// Index 0 is unused. Keep the array cache line aligned so the 16 keys
+	// at indexes 16k .. 16k+15 (4 levels below k) share one cache line.
+	bytes = ((size_t)(f->n + 1) * sizeof(int) + 63) & ~(size_t)63;
+	f->keys = aligned_alloc(64, bytes);
+	
+	// Walking the tree in order and the implicit tree in order at the
+	// same time drops every key straight into its final spot
+	cursor_begin(c);
+	for (k = eytzinger_first(f->n); k != 0; k = eytzinger_next(k, f->n))
+	{
+		node = cursor_next(c);
+		f->keys[k] = node->data;
+	}
+	
+	delete_cursor(c);
+	return f;
+}
 
-int	main(void)
+// Look up a value in a frozen tree. Every step is k = 2k or 2k+1 depending
+// on a comparison, which compiles to a conditional move instead of a branch.
+// The keys 4 levels down are prefetched since they all sit in one cache line.
+int frozen_lookup(struct frozen_tree* f, int value)
 {
-    struct node* root = NULL;
-    int choice, value;
+	int k = 1;
+	
+	while (k <= f->n)
+	{
+		__builtin_prefetch(f->keys + (size_t)k * 16);
+		k = 2 * k + (f->keys[k] < value);
+	}
+	
+	// We went right every time we saw a smaller key, so undoing the trailing
+	// right turns plus one left turn lands on the first key >= value
+	k >>= __builtin_ffs(~k);
+	
+	return k != 0 && f->keys[k] == value;
+}
+
+// Rebuild a regular tree from a frozen one so it can take updates again.
+// The implicit tree is complete, so linking node k to nodes 2k and 2k+1
+// gives a tree that is already balanced.
+struct tree* thaw_tree(struct frozen_tree* f, int balanced, int use_slab)
+{
+	struct tree* t;
+	struct node** nodes;
+	int k;
+	
+	t = create_tree(balanced, use_slab);
+	if (f->n == 0)
+		return t;
+	
+	nodes = malloc((f->n + 1) * sizeof(struct node*));
+	for (k = 1; k <= f->n; k++)
+	{
+		nodes[k] = alloc_node(t);
+		nodes[k]->data = f->keys[k];
+	}
+	
+	// Link from the bottom up so the children's heights are known
+	for (k = f->n; k >= 1; k--)
+	{
+		nodes[k]->left = 2 * k <= f->n ? nodes[2 * k] : NULL;
+		nodes[k]->right = 2 * k + 1 <= f->n ? nodes[2 * k + 1] : NULL;
+		update_height(nodes[k]);
+	}
+	
+	t->root = nodes[1];
+	free(nodes);
+	return t;
+}
+
+void delete_frozen_tree(struct frozen_tree* f)
+{
+	free(f->keys);
+	free(f);
+}
+
+// Time count random lookups against the tree and against a frozen copy of it
+void benchmark_frozen(struct tree* t, int count)
+{
+	struct frozen_tree* f;
+	struct node* node;
+	clock_t start;
+	double tree_time, frozen_time;
+	int i, low, high, found_tree, found_frozen;
+	int* values;
+	
+	if (t->root == NULL)
+	{
+		printf("The tree is empty!\n");
+		return;
+	}
+	
+	// Look for values spread over the range the tree covers
+	for (node = t->root; node->left != NULL; node = node->left)
+		;
+	low = node->data;
+	for (node = t->root; node->right != NULL; node = node->right)
+		;
+	high = node->data;
+	
+	values = malloc(count * sizeof(int));
+	for (i = 0; i < count; i++)
+		values[i] = low + (int)(rand() % ((long)high - low + 1));
+	
+	start = clock();
+	f = freeze_tree(t);
+	printf("Froze %d values in %.3f ms\n", f->n, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+	
+	found_tree = 0;
+	start = clock();
+	for (i = 0; i < count; i++)
+		found_tree += lookup(t->root, values[i]);
+	tree_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+	
+	found_frozen = 0;
+	start = clock();
+	for (i = 0; i < count; i++)
+		found_frozen += frozen_lookup(f, values[i]);
+	frozen_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+	
+	printf("Tree:   %d lookups, %d found, %.1f ns per lookup\n", count, found_tree, tree_time * 1e9 / count);
+	printf("Frozen: %d lookups, %d found, %.1f ns per lookup\n", count, found_frozen, frozen_time * 1e9 / count);
+	
+	delete_frozen_tree(f);
+	free(values);
+}
+
+int	main(int argc, char* argv[])
+{
+    // Plain binary search tree unless "avl" was asked for
+    struct tree* tree = create_tree(argc > 1 && strcmp(argv[1], "avl") == 0, 1);
+    int choice, value, high;
+    struct cursor* cursor;
+    struct node* node;
+    char filename[256];
+    clock_t start;
     
     do
     {
@@ -181,19 +871,24 @@ int	main(void)
         printf("2. Lookup\n");
         printf("3. Delete\n");
         printf("4. Print all elements\n");
+        printf("5. Print allocation stats\n");
+        printf("6. Print tree height\n");
+        printf("7. Print values in a range\n");
+        printf("8. Compare lookup speed against a frozen copy\n");
+        printf("9. Load values from a sorted file\n");
         printf("0. Quit\n");
         scanf("%d", &choice);        
         if(choice == 1)
         {
             printf("What value do you want to insert?\n");
             scanf("%d", &value);
-            insert(&root, value);
+            insert(tree, value);
         }
         else if(choice == 2)
         {
             printf("What value do you want to lookup?\n");
             scanf("%d", &value);
-            if(lookup(root, value))
+            if(lookup(tree->root, value))
             {
                 printf("Found it\n");   
             }   
@@ -206,7 +901,7 @@ int	main(void)
         {
             printf("What value do you want to delete?\n");
             scanf("%d", &value);
-            if(delete_node(&root, value))
+            if(delete_node(tree, value))
             {
                 printf("DELETED\n");
             } 
@@ -218,20 +913,62 @@ int	main(void)
         else if(choice == 4)
         {
             printf("In-order: ");
-            in_order(root);
+            in_order(tree->root);
             printf("\n");
             
             printf("Pre-order: ");
-            pre_order(root);
+            pre_order(tree->root);
             printf("\n");
             
             printf("Post-order: ");
-            post_order(root);
+            post_order(tree->root);
+            printf("\n");
+        }
+        else if(choice == 5)
+        {
+            slab_print_stats(tree->pool, "Node");
+        }
+        else if(choice == 6)
+        {
+            printf("Height: %d\n", tree_height(tree->root));
+        }
+        else if(choice == 7)
+        {
+            printf("What range of values do you want, low and high separated by a space?\n");
+            scanf("%d %d", &value, &high);
+            cursor = create_cursor(tree);
+            cursor_seek(cursor, value);
+            while((node = cursor_next(cursor)) != NULL && node->data <= high)
+            {
+                printf("%d ", node->data);
+            }
             printf("\n");
+            delete_cursor(cursor);
+        }
+        else if(choice == 8)
+        {
+            printf("How many random lookups do you want to time?\n");
+            scanf("%d", &value);
+            benchmark_frozen(tree, value);
+        }
+        else if(choice == 9)
+        {
+            printf("What file do you want to load?\n");
+            scanf("%255s", filename);
+            start = clock();
+            value = load_file(tree, filename);
+            if(value < 0)
+            {
+                printf("Couldn't open %s\n", filename);
+            }
+            else
+            {
+                printf("Loaded %d values in %.3f ms\n", value, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+            }
         }
     }while(choice != 0);    
     
-    free_tree(root);
+    free_tree(tree);
 	
 	system("PAUSE");
 	exit(0);
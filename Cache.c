@@ -0,0 +1,774 @@
+/*
+** A bounded cache of names, for putting in front of a slow backing store
+**
+** Every entry is on a doubly linked list (like DoublyLinkedList.c, with a tail and a
+** count) and in a chained hash table (like HashTable.c). The table finds an entry by
+** name, and the list keeps entries in the order they were last used, so moving an entry
+** to the front on a hit and evicting from the back when the cache is full are O(1).
+**
+** Time Complexity
+** Get:   O(1) expected (Hash the name, walk one short chain, relink one node)
+** Put:   O(1) expected (Same, plus at most one eviction from the back of a list)
+**
+** Two policies:
+**   LRU: one list, most recently used first. Whatever was used longest ago goes.
+**   ARC: Adaptive Replacement Cache (Megiddo and Modha). Entries seen once live on a
+**        "recent" list and entries seen again move to a "frequent" list. Names evicted
+**        from either list are remembered (just the name, no value) on a ghost list of
+**        their own. Getting a put for a name on the recent ghost list means the recent
+**        list was too short, and one on the frequent ghost list means the frequent list
+**        was, so the split between the two lists keeps adjusting to the workload. A big
+**        scan of names that are only used once just churns the recent list and can't
+**        push the frequently used names out, which is where plain LRU falls over.
+**        Run the program with "arc" to use it.
+**
+** A cache on its own isn't thread safe. The sharded version splits the capacity over
+** NUM_SHARDS caches, each with its own lock (on its own cache line), and picks the shard
+** from the name's hash, so threads only wait on each other when they use the same shard.
+** Run the program with "sharded" to use it. The menu can compare the hit rates of the two
+** policies and benchmark one shard against NUM_SHARDS on more and more threads.
+**
+** Build with -pthread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "Slab.h"
+
+#define MAX_LEN 100
+// Must be a power of two
+#define NUM_SHARDS 16
+#define CACHE_LINE 64
+// Entries in the cache the menu works on, small so evictions are easy to see
+#define MENU_CAPACITY 8
+
+enum cache_policy {
+	POLICY_LRU,
+	POLICY_ARC
+};
+
+// The lists an entry can be on. LRU only uses RECENT.
+enum cache_list_id {
+	RECENT,          // ARC: Seen once lately
+	FREQUENT,        // ARC: Seen at least twice lately
+	RECENT_GHOSTS,   // ARC: Evicted from RECENT, name only
+	FREQUENT_GHOSTS  // ARC: Evicted from FREQUENT, name only
+};
+
+struct cache_entry {
+	char* key;
+	uint64_t hash;
+	int value;  // Meaningless on a ghost
+	int list;   // Which list it's on
+	struct cache_entry* next; // Towards the back of its list (used longer ago)
+	struct cache_entry* prev;
+	struct cache_entry* chain; // Next entry in the same bucket
+};
+
+struct cache_list {
+	struct cache_entry* head; // Most recently used
+	struct cache_entry* tail; // Least recently used
+	int count;
+};
+
+struct cache {
+	enum cache_policy policy;
+	int capacity;  // Most entries with values, ARC remembers up to as many ghosts again
+	int target;    // ARC: how many of the cached entries should be on RECENT
+	struct cache_list lists[4];
+	struct cache_entry** buckets;
+	int num_buckets; // A power of two, sized up front so the table never grows
+	struct slab* pool;
+	// Stats
+	long hits;
+	long misses;
+	long evictions;
+	long ghost_hits; // ARC: puts for names on a ghost list
+};
+
+// One cache and its lock. Each shard starts on its own cache line, so
+// threads hammering different shards don't fight over one line.
+struct cache_shard {
+	_Alignas(CACHE_LINE) pthread_mutex_t lock;
+	struct cache* cache;
+};
+
+struct sharded_cache {
+	int num_shards; // A power of two
+	struct cache_shard* shards;
+};
+
+struct cache* cache_create(int capacity, enum cache_policy policy);
+int cache_get(struct cache* c, const char* key, int* value);
+void cache_put(struct cache* c, const char* key, int value);
+void cache_print(struct cache* c);
+void cache_print_stats(struct cache* c);
+void cache_destroy(struct cache* c);
+struct sharded_cache* sharded_create(int capacity, int num_shards, enum cache_policy policy);
+int sharded_get(struct sharded_cache* s, const char* key, int* value);
+void sharded_put(struct sharded_cache* s, const char* key, int value);
+void sharded_print(struct sharded_cache* s);
+void sharded_print_stats(struct sharded_cache* s);
+void sharded_destroy(struct sharded_cache* s);
+uint64_t hash_key(const char* key);
+void compare_policies(int capacity, int num_keys, int num_requests);
+void benchmark(int capacity, int num_keys, int seconds_per_run);
+
+int main(int argc, char* argv[])
+{
+	int i, choice, value, capacity, num_keys, num_requests;
+	enum cache_policy policy = POLICY_LRU;
+	int num_shards = 1;
+	char key[MAX_LEN];
+	struct sharded_cache* cache;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "arc") == 0)
+			policy = POLICY_ARC;
+		else if (strcmp(argv[i], "sharded") == 0)
+			num_shards = NUM_SHARDS;
+	}
+
+	// A single shard is just one cache behind one lock
+	cache = sharded_create(num_shards == 1 ? MENU_CAPACITY : MENU_CAPACITY * NUM_SHARDS, num_shards, policy);
+
+	printf("Welcome to the name cache!\n");
+	printf("%s cache, %d shard%s of %d entries\n\n", policy == POLICY_ARC ? "ARC" : "LRU",
+		   num_shards, num_shards == 1 ? "" : "s", MENU_CAPACITY);
+
+	do {
+		printf("1. Put a name and a value in the cache\n");
+		printf("2. Get a name from the cache\n");
+		printf("3. Print the cache\n");
+		printf("4. Print hit, miss and eviction counts\n");
+		printf("5. Compare LRU and ARC hit rates on a simulated workload\n");
+		printf("6. Benchmark on more and more threads\n");
+		printf("0. Exit program\n");
+		scanf("%d", &choice);
+
+		if (choice == 1)
+		{
+			printf("Please enter the name and its value, separated by a space\n");
+			scanf("%99s %d", key, &value);
+			sharded_put(cache, key, value);
+		}
+		else if (choice == 2)
+		{
+			printf("Please enter the name\n");
+			scanf("%99s", key);
+			if (sharded_get(cache, key, &value))
+				printf("Hit: %s has value %d\n\n", key, value);
+			else
+				printf("Miss: %s isn't in the cache\n\n", key);
+		}
+		else if (choice == 3)
+			sharded_print(cache);
+		else if (choice == 4)
+			sharded_print_stats(cache);
+		else if (choice == 5)
+		{
+			printf("Cache capacity, number of names and number of requests? (separated by spaces)\n");
+			scanf("%d %d %d", &capacity, &num_keys, &num_requests);
+			compare_policies(capacity, num_keys, num_requests);
+		}
+		else if (choice == 6)
+		{
+			printf("Cache capacity and number of names? (separated by a space)\n");
+			scanf("%d %d", &capacity, &num_keys);
+			benchmark(capacity, num_keys, 1);
+		}
+
+	} while (choice != 0);
+
+	sharded_destroy(cache);
+	system("PAUSE");
+	exit(0);
+}
+
+// FNV-1a, the low bits pick the bucket and the high bits the shard
+uint64_t hash_key(const char* key)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (; *key != '\0'; key++)
+	{
+		hash ^= (unsigned char)*key;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+// Create an empty cache that holds up to capacity values
+struct cache* cache_create(int capacity, enum cache_policy policy)
+{
+	struct cache* c;
+
+	c = calloc(1, sizeof(struct cache));
+	c->policy = policy;
+	c->capacity = capacity < 1 ? 1 : capacity;
+	c->target = 0;
+
+	// Room for every entry plus (for ARC) as many ghosts, at about one per bucket
+	c->num_buckets = 1;
+	while (c->num_buckets < c->capacity * 2)
+		c->num_buckets *= 2;
+	c->buckets = calloc(c->num_buckets, sizeof(struct cache_entry*));
+	c->pool = slab_create(sizeof(struct cache_entry));
+	return c;
+}
+
+static struct cache_entry* find_entry(struct cache* c, const char* key, uint64_t hash)
+{
+	struct cache_entry* e;
+
+	for (e = c->buckets[hash & (c->num_buckets - 1)]; e != NULL; e = e->chain)
+		if (e->hash == hash && strcmp(e->key, key) == 0)
+			return e;
+	return NULL;
+}
+
+// Put e at the front of list id
+static void push_front(struct cache* c, int id, struct cache_entry* e)
+{
+	struct cache_list* list = &c->lists[id];
+
+	e->list = id;
+	e->prev = NULL;
+	e->next = list->head;
+	if (list->head != NULL)
+		list->head->prev = e;
+	else
+		list->tail = e;
+	list->head = e;
+	list->count++;
+}
+
+// Take e off whichever list it's on
+static void unlink_entry(struct cache* c, struct cache_entry* e)
+{
+	struct cache_list* list = &c->lists[e->list];
+
+	if (e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		list->head = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		list->tail = e->prev;
+	list->count--;
+}
+
+static void move_to_front(struct cache* c, int id, struct cache_entry* e)
+{
+	unlink_entry(c, e);
+	push_front(c, id, e);
+}
+
+// Forget e completely, taking it out of its list and its bucket
+static void drop_entry(struct cache* c, struct cache_entry* e)
+{
+	struct cache_entry** link;
+
+	unlink_entry(c, e);
+	link = &c->buckets[e->hash & (c->num_buckets - 1)];
+	while (*link != e)
+		link = &(*link)->chain;
+	*link = e->chain;
+
+	free(e->key);
+	slab_free(c->pool, e);
+}
+
+// ARC: make room for one more value by evicting from the back of RECENT or
+// FREQUENT, whichever is over its share, and remembering the name as a ghost.
+// from_frequent_ghost says the name about to come in was a FREQUENT ghost.
+static void replace(struct cache* c, int from_frequent_ghost)
+{
+	int recent = c->lists[RECENT].count;
+
+	if (recent > 0 && (recent > c->target || (from_frequent_ghost && recent == c->target)))
+		move_to_front(c, RECENT_GHOSTS, c->lists[RECENT].tail);
+	else
+		move_to_front(c, FREQUENT_GHOSTS, c->lists[FREQUENT].tail);
+	c->evictions++;
+}
+
+// Look a name up. On a hit its value goes in *value and it becomes the most
+// recently used, returns 1. A miss changes nothing, returns 0, and the caller
+// is expected to go to the backing store and put the value.
+int cache_get(struct cache* c, const char* key, int* value)
+{
+	struct cache_entry* e = find_entry(c, key, hash_key(key));
+
+	if (e == NULL || e->list == RECENT_GHOSTS || e->list == FREQUENT_GHOSTS)
+	{
+		c->misses++;
+		return 0;
+	}
+
+	c->hits++;
+	*value = e->value;
+	// ARC: anything used a second time is frequent
+	move_to_front(c, c->policy == POLICY_ARC ? FREQUENT : RECENT, e);
+	return 1;
+}
+
+static struct cache_entry* new_entry(struct cache* c, const char* key, uint64_t hash)
+{
+	struct cache_entry* e;
+	size_t length = strlen(key);
+
+	e = slab_alloc(c->pool);
+	e->key = malloc(length + 1);
+	memcpy(e->key, key, length + 1);
+	e->hash = hash;
+	e->chain = c->buckets[hash & (c->num_buckets - 1)];
+	c->buckets[hash & (c->num_buckets - 1)] = e;
+	return e;
+}
+
+static void lru_put(struct cache* c, const char* key, uint64_t hash, int value)
+{
+	struct cache_entry* e = find_entry(c, key, hash);
+
+	if (e == NULL)
+	{
+		// Case: Full, so whatever was used longest ago has to go
+		if (c->lists[RECENT].count == c->capacity)
+		{
+			drop_entry(c, c->lists[RECENT].tail);
+			c->evictions++;
+		}
+		e = new_entry(c, key, hash);
+		push_front(c, RECENT, e);
+	}
+	else
+		move_to_front(c, RECENT, e);
+	e->value = value;
+}
+
+static void arc_put(struct cache* c, const char* key, uint64_t hash, int value)
+{
+	struct cache_entry* e = find_entry(c, key, hash);
+	int recent, recent_ghosts, frequent_ghosts, cached, total, step;
+
+	recent = c->lists[RECENT].count;
+	recent_ghosts = c->lists[RECENT_GHOSTS].count;
+	frequent_ghosts = c->lists[FREQUENT_GHOSTS].count;
+	cached = recent + c->lists[FREQUENT].count;
+	total = cached + recent_ghosts + frequent_ghosts;
+
+	// Case: Already cached, just a new value
+	if (e != NULL && (e->list == RECENT || e->list == FREQUENT))
+	{
+		e->value = value;
+		move_to_front(c, FREQUENT, e);
+		return;
+	}
+
+	// Case: Evicted from RECENT not long ago, so RECENT should get a bigger share
+	if (e != NULL && e->list == RECENT_GHOSTS)
+	{
+		c->ghost_hits++;
+		step = frequent_ghosts > recent_ghosts ? frequent_ghosts / recent_ghosts : 1;
+		c->target = c->target + step > c->capacity ? c->capacity : c->target + step;
+		if (cached >= c->capacity)
+			replace(c, 0);
+		e->value = value;
+		move_to_front(c, FREQUENT, e);
+		return;
+	}
+
+	// Case: Evicted from FREQUENT not long ago, so FREQUENT should get a bigger share
+	if (e != NULL && e->list == FREQUENT_GHOSTS)
+	{
+		c->ghost_hits++;
+		step = recent_ghosts > frequent_ghosts ? recent_ghosts / frequent_ghosts : 1;
+		c->target = c->target - step < 0 ? 0 : c->target - step;
+		if (cached >= c->capacity)
+			replace(c, 1);
+		e->value = value;
+		move_to_front(c, FREQUENT, e);
+		return;
+	}
+
+	// Case: Never seen (or long forgotten). Keep RECENT plus its ghosts within
+	//       capacity, and everything together within twice capacity.
+	if (recent + recent_ghosts >= c->capacity)
+	{
+		if (recent < c->capacity)
+		{
+			drop_entry(c, c->lists[RECENT_GHOSTS].tail);
+			if (cached >= c->capacity)
+				replace(c, 0);
+		}
+		else
+		{
+			// RECENT is the whole cache, there are no ghosts of it to drop
+			drop_entry(c, c->lists[RECENT].tail);
+			c->evictions++;
+		}
+	}
+	else if (total >= c->capacity)
+	{
+		if (total >= c->capacity * 2)
+			drop_entry(c, c->lists[FREQUENT_GHOSTS].tail);
+		if (cached >= c->capacity)
+			replace(c, 0);
+	}
+
+	e = new_entry(c, key, hash);
+	e->value = value;
+	push_front(c, RECENT, e);
+}
+
+// Add a name with its value, or give a name already in the cache a new
+// value. Either way it becomes the most recently used, evicting if needed.
+void cache_put(struct cache* c, const char* key, int value)
+{
+	if (c->policy == POLICY_ARC)
+		arc_put(c, key, hash_key(key), value);
+	else
+		lru_put(c, key, hash_key(key), value);
+}
+
+static void print_entries(struct cache* c, int id, const char* title)
+{
+	struct cache_entry* e;
+
+	printf("%s (%d):", title, c->lists[id].count);
+	for (e = c->lists[id].head; e != NULL; e = e->next)
+	{
+		if (id == RECENT || id == FREQUENT)
+			printf(" %s=%d", e->key, e->value);
+		else
+			printf(" %s", e->key);
+	}
+	printf("\n");
+}
+
+// Print every list, most recently used first
+void cache_print(struct cache* c)
+{
+	if (c->policy == POLICY_LRU)
+	{
+		print_entries(c, RECENT, "Most to least recently used");
+		return;
+	}
+	print_entries(c, RECENT, "Recent");
+	print_entries(c, FREQUENT, "Frequent");
+	print_entries(c, RECENT_GHOSTS, "Recent ghosts");
+	print_entries(c, FREQUENT_GHOSTS, "Frequent ghosts");
+	printf("Recent is aiming for %d of the %d entries\n", c->target, c->capacity);
+}
+
+void cache_print_stats(struct cache* c)
+{
+	long requests = c->hits + c->misses;
+
+	printf("\nHits: %ld  Misses: %ld  Hit rate: %.1f%%\n", c->hits, c->misses,
+		   requests > 0 ? 100.0 * c->hits / requests : 0.0);
+	printf("Evictions: %ld", c->evictions);
+	if (c->policy == POLICY_ARC)
+		printf("  Ghost hits: %ld", c->ghost_hits);
+	printf("\nEntries: %d of %d\n\n", c->lists[RECENT].count + c->lists[FREQUENT].count, c->capacity);
+}
+
+void cache_destroy(struct cache* c)
+{
+	struct cache_entry* e;
+	int i;
+
+	// Every entry goes away at once with the slab, but the keys were malloced
+	for (i = 0; i < 4; i++)
+		for (e = c->lists[i].head; e != NULL; e = e->next)
+			free(e->key);
+	slab_destroy(c->pool);
+	free(c->buckets);
+	free(c);
+}
+
+// Create a cache of capacity entries split over num_shards (a power of two)
+// caches, each behind its own lock
+struct sharded_cache* sharded_create(int capacity, int num_shards, enum cache_policy policy)
+{
+	struct sharded_cache* s;
+	int i;
+
+	s = malloc(sizeof(struct sharded_cache));
+	s->num_shards = num_shards;
+	s->shards = aligned_alloc(CACHE_LINE, num_shards * sizeof(struct cache_shard));
+	for (i = 0; i < num_shards; i++)
+	{
+		pthread_mutex_init(&s->shards[i].lock, NULL);
+		// Spread what doesn't divide evenly over the first shards
+		s->shards[i].cache = cache_create(capacity / num_shards + (i < capacity % num_shards), policy);
+	}
+	return s;
+}
+
+// The top bits pick the shard, so they don't line up with the buckets inside it
+static struct cache_shard* shard_of(struct sharded_cache* s, const char* key)
+{
+	return &s->shards[(hash_key(key) >> 40) & (s->num_shards - 1)];
+}
+
+int sharded_get(struct sharded_cache* s, const char* key, int* value)
+{
+	struct cache_shard* shard = shard_of(s, key);
+	int hit;
+
+	pthread_mutex_lock(&shard->lock);
+	hit = cache_get(shard->cache, key, value);
+	pthread_mutex_unlock(&shard->lock);
+	return hit;
+}
+
+void sharded_put(struct sharded_cache* s, const char* key, int value)
+{
+	struct cache_shard* shard = shard_of(s, key);
+
+	pthread_mutex_lock(&shard->lock);
+	cache_put(shard->cache, key, value);
+	pthread_mutex_unlock(&shard->lock);
+}
+
+void sharded_print(struct sharded_cache* s)
+{
+	int i;
+
+	printf("\n");
+	for (i = 0; i < s->num_shards; i++)
+	{
+		pthread_mutex_lock(&s->shards[i].lock);
+		if (s->num_shards > 1)
+			printf("Shard %d\n", i);
+		cache_print(s->shards[i].cache);
+		pthread_mutex_unlock(&s->shards[i].lock);
+	}
+	printf("\n");
+}
+
+// Add up every shard's counts and print them like one cache's
+void sharded_print_stats(struct sharded_cache* s)
+{
+	struct cache total;
+	struct cache* c;
+	int i;
+
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < s->num_shards; i++)
+	{
+		pthread_mutex_lock(&s->shards[i].lock);
+		c = s->shards[i].cache;
+		total.policy = c->policy;
+		total.capacity += c->capacity;
+		total.hits += c->hits;
+		total.misses += c->misses;
+		total.evictions += c->evictions;
+		total.ghost_hits += c->ghost_hits;
+		total.lists[RECENT].count += c->lists[RECENT].count;
+		total.lists[FREQUENT].count += c->lists[FREQUENT].count;
+		pthread_mutex_unlock(&s->shards[i].lock);
+	}
+	cache_print_stats(&total);
+}
+
+void sharded_destroy(struct sharded_cache* s)
+{
+	int i;
+
+	for (i = 0; i < s->num_shards; i++)
+	{
+		pthread_mutex_destroy(&s->shards[i].lock);
+		cache_destroy(s->shards[i].cache);
+	}
+	free(s->shards);
+	free(s);
+}
+
+// xorshift, rand() takes a global lock in some C libraries
+static uint64_t next_random(uint64_t* rng)
+{
+	*rng ^= *rng << 13;
+	*rng ^= *rng >> 7;
+	*rng ^= *rng << 17;
+	return *rng;
+}
+
+// A request from a skewed workload: most requests go to a small hot set of
+// names, the rest anywhere, and every so often a long scan of names that are
+// never asked for again comes through
+static int next_request(uint64_t* rng, int num_keys, long i, int* scan_left, long* scan_next)
+{
+	uint64_t r = next_random(rng);
+
+	if (*scan_left > 0)
+	{
+		(*scan_left)--;
+		return num_keys + (int)((*scan_next)++ % 1000000000);
+	}
+	if (i % (num_keys * 4L) == 0)
+		*scan_left = num_keys / 4;
+	if (r % 100 < 80)
+		return (int)((r >> 8) % (num_keys / 10 + 1));
+	return (int)((r >> 8) % num_keys);
+}
+
+// Run the same requests through an LRU and an ARC cache, putting the
+// value on every miss like a real caller would, and print the hit rates
+void compare_policies(int capacity, int num_keys, int num_requests)
+{
+	enum cache_policy policies[2] = { POLICY_LRU, POLICY_ARC };
+	const char* names[2] = { "LRU", "ARC" };
+	struct cache* c;
+	char key[MAX_LEN];
+	uint64_t rng;
+	long i, scan_next;
+	int p, k, value, scan_left;
+
+	if (capacity <= 0 || num_keys <= 0 || num_requests <= 0)
+		return;
+
+	printf("\n%d entries, %d names (80%% of requests to %d of them), scans of %d\n",
+		   capacity, num_keys, num_keys / 10 + 1, num_keys / 4);
+	for (p = 0; p < 2; p++)
+	{
+		c = cache_create(capacity, policies[p]);
+		rng = 0x9e3779b97f4a7c15ULL;
+		scan_left = 0;
+		scan_next = 0;
+		for (i = 0; i < num_requests; i++)
+		{
+			k = next_request(&rng, num_keys, i, &scan_left, &scan_next);
+			sprintf(key, "name%d", k);
+			if (!cache_get(c, key, &value))
+				cache_put(c, key, k);
+		}
+		printf("%s", names[p]);
+		cache_print_stats(c);
+		cache_destroy(c);
+	}
+}
+
+// What each benchmark thread gets to work with
+struct bench_thread {
+	pthread_t thread;
+	struct sharded_cache* cache;
+	int num_keys;
+	atomic_int* stop;
+	uint64_t rng;
+	long ops;
+};
+
+// Get random names until told to stop, putting them on a miss
+static void* bench_worker(void* arg)
+{
+	struct bench_thread* b = arg;
+	char key[MAX_LEN];
+	uint64_t r;
+	int k, value;
+	long ops = 0;
+
+	while (!atomic_load_explicit(b->stop, memory_order_relaxed))
+	{
+		r = next_random(&b->rng);
+		k = (int)((r >> 8) % b->num_keys);
+		sprintf(key, "name%d", k);
+		if (!sharded_get(b->cache, key, &value))
+			sharded_put(b->cache, key, k);
+		ops++;
+	}
+
+	b->ops = ops;
+	return NULL;
+}
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run num_threads threads against s for the given time, returns operations per second
+static double bench_run(struct sharded_cache* s, int num_keys, int num_threads, int seconds)
+{
+	struct bench_thread* threads;
+	atomic_int stop = 0;
+	double start, elapsed;
+	long total = 0;
+	int i;
+
+	threads = malloc(num_threads * sizeof(struct bench_thread));
+	start = now_seconds();
+	for (i = 0; i < num_threads; i++)
+	{
+		threads[i].cache = s;
+		threads[i].num_keys = num_keys;
+		threads[i].stop = &stop;
+		threads[i].rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+		pthread_create(&threads[i].thread, NULL, bench_worker, &threads[i]);
+	}
+
+	sleep(seconds);
+	atomic_store(&stop, 1);
+
+	for (i = 0; i < num_threads; i++)
+	{
+		pthread_join(threads[i].thread, NULL);
+		total += threads[i].ops;
+	}
+	elapsed = now_seconds() - start;
+
+	free(threads);
+	return total / elapsed;
+}
+
+// Time an LRU cache behind one lock against one split into NUM_SHARDS,
+// on 1, 2, 4, ... threads up to the core count
+void benchmark(int capacity, int num_keys, int seconds_per_run)
+{
+	struct sharded_cache* single;
+	struct sharded_cache* sharded;
+	double one, many;
+	long cores;
+	int num_threads;
+
+	if (capacity <= 0 || num_keys <= 0)
+		return;
+
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1)
+		cores = 1;
+
+	single = sharded_create(capacity, 1, POLICY_LRU);
+	sharded = sharded_create(capacity, NUM_SHARDS, POLICY_LRU);
+
+	printf("\n%d entries, %d names, %ld cores\n", capacity, num_keys, cores);
+	printf("threads   1 lock (ops/sec)   %d shards (ops/sec)\n", NUM_SHARDS);
+	for (num_threads = 1; ; num_threads *= 2)
+	{
+		if (num_threads > cores)
+			num_threads = cores;
+
+		one = bench_run(single, num_keys, num_threads, seconds_per_run);
+		many = bench_run(sharded, num_keys, num_threads, seconds_per_run);
+		printf("%7d   %16.0f   %19.0f\n", num_threads, one, many);
+
+		if (num_threads == cores)
+			break;
+	}
+
+	sharded_print_stats(sharded);
+	sharded_destroy(single);
+	sharded_destroy(sharded);
+}
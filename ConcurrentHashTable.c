@@ -0,0 +1,940 @@
+/*
+** A thread safe version of the people hash table with lock striping
+**
+** The buckets are split into NUM_STRIPES stripes (bucket i belongs to stripe
+** i % NUM_STRIPES) and every stripe has its own reader/writer lock. Lookups only
+** take the read lock of the stripe their name hashes to, so any number of threads
+** can look people up at once, and a thread inserting or removing someone only
+** blocks threads that need that same stripe. Everything else keeps running.
+**
+** The number of buckets is always a power of two and a multiple of the number
+** of stripes, so a person's stripe only depends on the hash and never changes
+** when the table grows. That lets every stripe keep its own count and its own
+** slab of people, so nothing shared gets written on a normal insert or remove.
+** Growing the table is the one thing that takes every stripe's lock.
+**
+** Time Complexity
+** Access: O(1) - Assuming we don't have to search chains
+** Insert: O(1)
+** Delete: O(1)
+**
+** A table can also be created in RCU mode (run the program with "rcu"), where lookups
+** take no locks at all. Writers still lock their stripe to keep out other writers, but
+** they never change anything a reader might be in the middle of: people get filled in
+** before being linked into a chain, and a removed person keeps pointing at the rest of
+** their chain. They can't be freed right away, since a reader may still be on them, so
+** they are retired with the current epoch. Every reader notes the epoch it started in,
+** and once every reader still going started after a person was retired, nobody can be
+** on them anymore and they go back to the slab. Growing and reloading the table build
+** a whole new bucket array with copies of everyone, switch over to it in one store,
+** and retire the old array and people the same way. A lookup then costs one store to
+** the thread's own slot plus a fence, and readers never write to anything shared, so
+** lookups scale with the number of cores even while people are removed or reloaded.
+**
+** Build with -pthread. The menu can run a lookup benchmark on 1 thread up to one
+** thread per core, against this table and against the same table with a single
+** lock for everything (one stripe), which is what a global mutex gets you.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "Slab.h"
+
+#define MAX_LEN 100
+// Must be a power of two
+#define NUM_STRIPES 64
+#define INITIAL_LEN 64
+// Grow once the average chain in a stripe is longer than this
+#define MAX_LOAD 2.0
+#define CACHE_LINE 64
+// Most threads that can read RCU tables at once
+#define MAX_READERS 256
+// Try to free retired people every time this many more pile up in a stripe
+#define RECLAIM_BATCH 64
+
+struct person {
+	char first_name[MAX_LEN];
+	char last_name[MAX_LEN];
+	int id;
+	struct person* next; // Always read with load_link and written with publish
+};
+
+// The bucket array, with its length, so readers that don't take locks
+// can pick up both at once with a single load of the pointer
+struct buckets {
+	int length;
+	struct person* heads[];
+};
+
+// Something a reader might still be looking at, and the epoch it was unlinked in
+struct retired_person {
+	struct person* p;
+	uint64_t epoch;
+};
+
+struct retired_buckets {
+	struct buckets* b;
+	uint64_t epoch;
+	struct retired_buckets* next;
+};
+
+// One lock and everything it protects. Each stripe starts on its own cache
+// line, so threads hammering different stripes don't fight over one line.
+struct stripe {
+	_Alignas(CACHE_LINE) pthread_rwlock_t lock;
+	int num_elements;  // People in this stripe's buckets
+	struct slab* pool; // People in this stripe come from here
+	// RCU tables: people removed from this stripe, oldest first, that
+	// can't go back to the pool until no reader can still be on them
+	struct retired_person* retired;
+	int num_retired;
+	int retired_capacity;
+};
+
+struct hashtable
+{
+	struct buckets* buckets; // Only replaced with every stripe locked
+	int num_stripes;
+	struct stripe* stripes;
+	int rcu; // Readers don't take locks, see rcu_read_lock
+	struct retired_buckets* retired_buckets; // Only touched with every stripe locked
+};
+
+// Every thread that reads an RCU table gets one of these. epoch is the
+// global epoch when it started its current lookup, or 0 between lookups.
+struct reader {
+	_Alignas(CACHE_LINE) _Atomic uint64_t epoch;
+	atomic_int in_use;
+};
+
+static struct reader readers[MAX_READERS];
+static atomic_int num_readers; // Slots at or past this have never been used
+static _Atomic uint64_t global_epoch = 1;
+static _Thread_local struct reader* this_reader;
+
+struct hashtable* new_hashtable(int num_stripes, int rcu);
+void insert(struct hashtable* h, char first_name[], char last_name[], int id);
+int lookup(struct hashtable* h, char first_name[], char last_name[], int ids[], int max_ids);
+int remove_person(struct hashtable* h, char first_name[], char last_name[], int pid);
+int reload(struct hashtable* h, const char* filename);
+void print_table(struct hashtable* h);
+void delete_hashtable(struct hashtable* h);
+uint64_t hash_function(const char* first_name, const char* last_name);
+void rcu_register_thread(void);
+void rcu_unregister_thread(void);
+void benchmark(int num_people, int seconds_per_run, int write_percent);
+
+int main(int argc, char* argv[])
+{
+	int i, choice, num_entries, pid, seen, write_percent;
+	int ids[16];
+	FILE *fp;
+	char first_name[MAX_LEN];
+	char last_name[MAX_LEN];
+	struct hashtable* my_hashtable;
+
+	// Open database file for reading
+	fp = fopen("HashPeople.txt", "r");
+	if (fp == NULL)
+	{
+		printf("Sorry, we could not open the database file!\n");
+		return 0;
+	}
+
+	// Lookups take a read lock unless "rcu" was asked for
+	my_hashtable = new_hashtable(NUM_STRIPES, argc > 1 && strcmp(argv[1], "rcu") == 0);
+
+	// How many people are we scanning in?
+	fscanf(fp, "%d", &num_entries);
+	for (i = 0; i < num_entries; i++)
+	{
+		fscanf(fp, "%s", first_name);
+		fscanf(fp, "%s", last_name);
+		fscanf(fp, "%d", &pid);
+		insert(my_hashtable, first_name, last_name, pid);
+	}
+
+	// Close file after reading
+	fclose(fp);
+
+	printf("Welcome to the HashPeople Database!\n");
+	printf("Now safe to search from as many threads as you like\n\n\n");
+
+	do {
+		printf("1. Look up by first and last name\n");
+		printf("2. Remove a person by first and last name\n");
+		printf("3. Print hash table\n");
+		printf("4. Benchmark lookups on more and more threads\n");
+		printf("5. Reload the database file\n");
+		printf("0. Exit program\n");
+		scanf("%d", &choice);
+
+		if (choice == 1 || choice == 2)
+		{
+			printf("Please enter the first and last name, separated by a space\n");
+			scanf("%s %s", first_name, last_name);
+
+			seen = lookup(my_hashtable, first_name, last_name, ids, 16);
+			if (seen == 0)
+				printf("I'm sorry, I could not find %s %s in the database\n\n", first_name, last_name);
+			for (i = 0; i < seen && i < 16; i++)
+				printf("Found name: %s %s  Personal ID: %d\n", first_name, last_name, ids[i]);
+			printf("\n");
+
+			if (choice == 2 && seen != 0)
+			{
+				printf("Now that we found the person you wish to remove, please enter their ID to delete them\n");
+				scanf("%d", &pid);
+
+				if (remove_person(my_hashtable, first_name, last_name, pid))
+					printf("Successfully removed %s %s ID: %d\n", first_name, last_name, pid);
+				else
+					printf("There was an error removing %s %s, please make sure you entered the correct ID\n", first_name, last_name);
+			}
+		}
+		else if (choice == 3)
+			print_table(my_hashtable);
+		else if (choice == 4)
+		{
+			printf("How many people, and what percent of operations should be writes? (separated by a space)\n");
+			scanf("%d %d", &num_entries, &write_percent);
+			benchmark(num_entries, 1, write_percent);
+		}
+		else if (choice == 5)
+		{
+			num_entries = reload(my_hashtable, "HashPeople.txt");
+			if (num_entries < 0)
+				printf("Sorry, we could not open the database file!\n");
+			else
+				printf("Reloaded %d people\n", num_entries);
+		}
+
+	} while (choice != 0);
+
+	delete_hashtable(my_hashtable);
+	system("PAUSE");
+	exit(0);
+}
+
+// Links are read and written while RCU readers walk the chains with no
+// locks. On x86 these are ordinary loads and stores, they just keep the
+// compiler (and weaker CPUs) from reordering the stores that fill in a
+// person past the store that links them in.
+static struct person* load_link(struct person** link)
+{
+	return __atomic_load_n(link, __ATOMIC_ACQUIRE);
+}
+
+static void publish(struct person** link, struct person* p)
+{
+	__atomic_store_n(link, p, __ATOMIC_RELEASE);
+}
+
+static struct buckets* new_buckets(int length)
+{
+	struct buckets* b;
+	// Use calloc to initialize to zeros
+	b = calloc(1, sizeof(struct buckets) + length * sizeof(struct person*));
+	b->length = length;
+	return b;
+}
+
+// Create a new hash table with num_stripes locks (a power of two).
+// One stripe means one lock for the whole table. If rcu is set
+// lookups don't take any locks at all.
+struct hashtable* new_hashtable(int num_stripes, int rcu)
+{
+	struct hashtable* h;
+	int i;
+
+	h = malloc(sizeof(struct hashtable));
+	h->num_stripes = num_stripes;
+	h->rcu = rcu;
+	h->retired_buckets = NULL;
+	h->buckets = new_buckets(INITIAL_LEN > num_stripes ? INITIAL_LEN : num_stripes);
+	h->stripes = aligned_alloc(CACHE_LINE, num_stripes * sizeof(struct stripe));
+	for (i = 0; i < num_stripes; i++)
+	{
+		pthread_rwlock_init(&h->stripes[i].lock, NULL);
+		h->stripes[i].num_elements = 0;
+		h->stripes[i].pool = slab_create(sizeof(struct person));
+		h->stripes[i].retired = NULL;
+		h->stripes[i].num_retired = 0;
+		h->stripes[i].retired_capacity = 0;
+	}
+	return h;
+}
+
+// FNV-1a over both names with case folded, then mixed so the low bits
+// (which pick the stripe and the bucket) depend on every input bit
+uint64_t hash_function(const char* first_name, const char* last_name)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (; *first_name != '\0'; first_name++)
+		hash = (hash ^ (unsigned char)tolower((unsigned char)*first_name)) * 0x100000001b3ULL;
+	// Keep "ab c" and "a bc" apart
+	hash = (hash ^ ' ') * 0x100000001b3ULL;
+	for (; *last_name != '\0'; last_name++)
+		hash = (hash ^ (unsigned char)tolower((unsigned char)*last_name)) * 0x100000001b3ULL;
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// Compare two names ignoring case without copying either of them
+static int same_name(const char* a, const char* b)
+{
+	while (*a != '\0' && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+	{
+		a++;
+		b++;
+	}
+	return tolower((unsigned char)*a) == tolower((unsigned char)*b);
+}
+
+static struct stripe* stripe_for(struct hashtable* h, uint64_t hash)
+{
+	return &h->stripes[hash & (h->num_stripes - 1)];
+}
+
+// Grab a reader slot for the calling thread. Lookups on RCU tables do this
+// on their own the first time a thread needs it, but threads that come and
+// go should call rcu_unregister_thread before exiting to give the slot back.
+void rcu_register_thread(void)
+{
+	int i, expected, high;
+
+	if (this_reader != NULL)
+		return;
+
+	for (i = 0; i < MAX_READERS; i++)
+	{
+		expected = 0;
+		if (atomic_compare_exchange_strong(&readers[i].in_use, &expected, 1))
+			break;
+	}
+	if (i == MAX_READERS)
+	{
+		printf("More than %d threads are reading at once!\n", MAX_READERS);
+		exit(1);
+	}
+
+	// Make sure writers scan far enough to see this slot
+	high = atomic_load(&num_readers);
+	while (high <= i && !atomic_compare_exchange_weak(&num_readers, &high, i + 1))
+		;
+	this_reader = &readers[i];
+}
+
+void rcu_unregister_thread(void)
+{
+	if (this_reader == NULL)
+		return;
+	atomic_store(&this_reader->epoch, 0);
+	atomic_store(&this_reader->in_use, 0);
+	this_reader = NULL;
+}
+
+// Start reading an RCU table. All it costs is a store to this thread's own
+// slot and a fence: no locks, and nothing other readers touch.
+static void rcu_read_lock(void)
+{
+	if (this_reader == NULL)
+		rcu_register_thread();
+
+	atomic_store_explicit(&this_reader->epoch, atomic_load_explicit(&global_epoch, memory_order_acquire),
+						  memory_order_relaxed);
+	// Writers must see our epoch before we read any links
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+static void rcu_read_unlock(void)
+{
+	atomic_store_explicit(&this_reader->epoch, 0, memory_order_release);
+}
+
+// Called after unlinking something readers might be looking at. Returns the
+// epoch to retire it under: any reader that started after this can't find it.
+static uint64_t retire_epoch(void)
+{
+	return atomic_fetch_add(&global_epoch, 1);
+}
+
+// The oldest epoch a reader is still reading in. Anything retired before
+// it is safe to free. UINT64_MAX if nobody is reading right now.
+static uint64_t oldest_reader(void)
+{
+	uint64_t oldest = UINT64_MAX, epoch;
+	int i, n;
+
+	atomic_thread_fence(memory_order_seq_cst);
+	n = atomic_load(&num_readers);
+	for (i = 0; i < n; i++)
+	{
+		epoch = atomic_load(&readers[i].epoch);
+		if (epoch != 0 && epoch < oldest)
+			oldest = epoch;
+	}
+	return oldest;
+}
+
+// Give retired people back to the pool once no reader can be on them.
+// Must hold the stripe's lock.
+static void reclaim(struct stripe* s)
+{
+	uint64_t oldest;
+	int i = 0;
+
+	if (s->num_retired == 0)
+		return;
+
+	// The list is oldest first, so stop at the first one still in use
+	oldest = oldest_reader();
+	while (i < s->num_retired && s->retired[i].epoch < oldest)
+		slab_free(s->pool, s->retired[i++].p);
+
+	memmove(s->retired, &s->retired[i], (s->num_retired - i) * sizeof(struct retired_person));
+	s->num_retired -= i;
+}
+
+// Get rid of a person who was just unlinked. Must hold the stripe's lock.
+// Without RCU nobody else can be looking at them, so they go right away.
+static void retire_person(struct hashtable* h, struct stripe* s, struct person* p, uint64_t epoch)
+{
+	if (!h->rcu)
+	{
+		slab_free(s->pool, p);
+		return;
+	}
+
+	if (s->num_retired == s->retired_capacity)
+	{
+		s->retired_capacity = s->retired_capacity == 0 ? 64 : s->retired_capacity * 2;
+		s->retired = realloc(s->retired, s->retired_capacity * sizeof(struct retired_person));
+	}
+	s->retired[s->num_retired].p = p;
+	s->retired[s->num_retired].epoch = epoch;
+	s->num_retired++;
+
+	// Every so often see what can be freed, so the list stays short
+	if (s->num_retired % RECLAIM_BATCH == 0)
+		reclaim(s);
+}
+
+// Get rid of a bucket array that was just replaced, once no reader can be
+// using it. Must hold every stripe's lock.
+static void retire_buckets(struct hashtable* h, struct buckets* b, uint64_t epoch)
+{
+	struct retired_buckets* old;
+	struct retired_buckets** link;
+	uint64_t oldest;
+
+	if (!h->rcu)
+	{
+		free(b);
+		return;
+	}
+
+	old = malloc(sizeof(struct retired_buckets));
+	old->b = b;
+	old->epoch = epoch;
+	old->next = h->retired_buckets;
+	h->retired_buckets = old;
+
+	// Free the older arrays readers are done with, the list is newest first
+	oldest = oldest_reader();
+	for (link = &h->retired_buckets; *link != NULL; )
+	{
+		if ((*link)->epoch < oldest)
+		{
+			old = *link;
+			*link = old->next;
+			free(old->b);
+			free(old);
+		}
+		else
+			link = &(*link)->next;
+	}
+}
+
+// Link a person into the chain starting at link, keeping it sorted by first name.
+// Everything about p must be filled in first, readers may see it right away.
+static void chain_insert(struct person** link, struct person* p)
+{
+	struct person* next;
+
+	while ((next = load_link(link)) != NULL && strcmp(next->first_name, p->first_name) <= 0)
+		link = &next->next;
+	p->next = next;
+	publish(link, p);
+}
+
+static void lock_all(struct hashtable* h)
+{
+	int i;
+	// Always in the same order so two threads doing this can't deadlock
+	for (i = 0; i < h->num_stripes; i++)
+		pthread_rwlock_wrlock(&h->stripes[i].lock);
+}
+
+static void unlock_all(struct hashtable* h)
+{
+	int i;
+	for (i = h->num_stripes - 1; i >= 0; i--)
+		pthread_rwlock_unlock(&h->stripes[i].lock);
+}
+
+// Double the number of buckets, with every stripe locked
+static void grow(struct hashtable* h, int old_length)
+{
+	struct buckets* old;
+	struct buckets* b;
+	struct person* current_node;
+	struct person* next;
+	struct person* copy;
+	struct stripe* s;
+	uint64_t hash, epoch;
+	int i;
+
+	lock_all(h);
+
+	old = h->buckets;
+	// Case: Someone else grew the table while we were waiting
+	if (old->length != old_length)
+	{
+		unlock_all(h);
+		return;
+	}
+
+	b = new_buckets(old_length * 2);
+
+	if (!h->rcu)
+	{
+		// Every bucket i splits into buckets i and i + old_length, and
+		// keeping the chains in order keeps them sorted by first name
+		for (i = 0; i < old_length; i++)
+		{
+			struct person** tails[2] = { &b->heads[i], &b->heads[i + old_length] };
+
+			for (current_node = old->heads[i]; current_node != NULL; current_node = next)
+			{
+				int half = (hash_function(current_node->first_name, current_node->last_name) & old_length) != 0;
+				next = current_node->next;
+				*tails[half] = current_node;
+				tails[half] = &current_node->next;
+			}
+			*tails[0] = NULL;
+			*tails[1] = NULL;
+		}
+		h->buckets = b;
+		retire_buckets(h, old, 0);
+		unlock_all(h);
+		return;
+	}
+
+	// Readers may be walking the old chains right now, so leave them alone
+	// and build the new array out of copies. The old people are retired once
+	// the new array is out there, so no new reader can find them.
+	for (i = 0; i < old_length; i++)
+	{
+		for (current_node = old->heads[i]; current_node != NULL; current_node = current_node->next)
+		{
+			hash = hash_function(current_node->first_name, current_node->last_name);
+			copy = slab_alloc(stripe_for(h, hash)->pool);
+			memcpy(copy, current_node, sizeof(struct person));
+			chain_insert(&b->heads[hash & (b->length - 1)], copy);
+		}
+	}
+	__atomic_store_n(&h->buckets, b, __ATOMIC_RELEASE);
+
+	epoch = retire_epoch();
+	for (i = 0; i < old_length; i++)
+	{
+		for (current_node = old->heads[i]; current_node != NULL; current_node = next)
+		{
+			next = current_node->next;
+			s = stripe_for(h, hash_function(current_node->first_name, current_node->last_name));
+			retire_person(h, s, current_node, epoch);
+		}
+	}
+	retire_buckets(h, old, epoch);
+
+	unlock_all(h);
+}
+
+// Insert a person, keeping each chain sorted by first name
+void insert(struct hashtable* h, char first_name[], char last_name[], int id)
+{
+	uint64_t hash = hash_function(first_name, last_name);
+	struct stripe* s = stripe_for(h, hash);
+	struct buckets* b;
+	struct person* p;
+	int length, full;
+
+	pthread_rwlock_wrlock(&s->lock);
+
+	p = slab_alloc(s->pool);
+	strcpy(p->first_name, first_name);
+	strcpy(p->last_name, last_name);
+	p->id = id;
+
+	// The bucket array can't change while we hold a stripe lock
+	b = h->buckets;
+	chain_insert(&b->heads[hash & (b->length - 1)], p);
+
+	s->num_elements++;
+	length = b->length;
+	full = s->num_elements > MAX_LOAD * length / h->num_stripes;
+
+	pthread_rwlock_unlock(&s->lock);
+
+	if (full)
+		grow(h, length);
+}
+
+// Find everyone matching the first and last name. Up to max_ids of their IDs
+// are copied into ids, since the people themselves can be removed by another
+// thread as soon as we're done looking. Returns how many matched.
+int lookup(struct hashtable* h, char first_name[], char last_name[], int ids[], int max_ids)
+{
+	uint64_t hash = hash_function(first_name, last_name);
+	struct stripe* s = stripe_for(h, hash);
+	struct buckets* b;
+	struct person* current_node;
+	int seen = 0;
+
+	if (h->rcu)
+		rcu_read_lock();
+	else
+		pthread_rwlock_rdlock(&s->lock);
+
+	b = __atomic_load_n(&h->buckets, __ATOMIC_ACQUIRE);
+	for (current_node = load_link(&b->heads[hash & (b->length - 1)]); current_node != NULL;
+		 current_node = load_link(&current_node->next))
+	{
+		if (same_name(current_node->first_name, first_name) && same_name(current_node->last_name, last_name))
+		{
+			if (seen < max_ids)
+				ids[seen] = current_node->id;
+			seen++;
+		}
+	}
+
+	if (h->rcu)
+		rcu_read_unlock();
+	else
+		pthread_rwlock_unlock(&s->lock);
+	return seen;
+}
+
+// Remove the person with a matching name and ID, returns 1 if they were there
+int remove_person(struct hashtable* h, char first_name[], char last_name[], int pid)
+{
+	uint64_t hash = hash_function(first_name, last_name);
+	struct stripe* s = stripe_for(h, hash);
+	struct buckets* b;
+	struct person** link;
+	struct person* temp;
+	int removed = 0;
+
+	pthread_rwlock_wrlock(&s->lock);
+
+	b = h->buckets;
+	for (link = &b->heads[hash & (b->length - 1)]; *link != NULL; link = &(*link)->next)
+	{
+		if ((*link)->id == pid && same_name((*link)->first_name, first_name) &&
+			same_name((*link)->last_name, last_name))
+		{
+			// A reader on temp still gets to the rest of the chain
+			// through temp->next, so leave that alone
+			temp = *link;
+			publish(link, temp->next);
+			retire_person(h, s, temp, h->rcu ? retire_epoch() : 0);
+			s->num_elements--;
+			removed = 1;
+			break;
+		}
+	}
+
+	pthread_rwlock_unlock(&s->lock);
+	return removed;
+}
+
+// Replace everyone in the table with the people in a database file.
+// Readers of an RCU table carry on with the old people the whole time and
+// switch over all at once. Returns the number of people read, or -1 if the
+// file couldn't be opened (the table is left alone then).
+int reload(struct hashtable* h, const char* filename)
+{
+	FILE* fp;
+	struct person* people = NULL;
+	struct buckets* old;
+	struct buckets* b;
+	struct person* current_node;
+	struct person* next;
+	struct person* p;
+	struct stripe* s;
+	uint64_t hash, epoch;
+	int i, num_entries, length;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+
+	// Read the file before locking anything so writers only wait for the swap
+	if (fscanf(fp, "%d", &num_entries) != 1 || num_entries < 0)
+		num_entries = 0;
+	people = malloc((num_entries + 1) * sizeof(struct person));
+	for (i = 0; i < num_entries; i++)
+	{
+		if (fscanf(fp, "%99s %99s %d", people[i].first_name, people[i].last_name, &people[i].id) != 3)
+			break;
+	}
+	num_entries = i;
+	fclose(fp);
+
+	length = INITIAL_LEN > h->num_stripes ? INITIAL_LEN : h->num_stripes;
+	while (num_entries > length)
+		length *= 2;
+	b = new_buckets(length);
+
+	lock_all(h);
+
+	old = h->buckets;
+	for (i = 0; i < h->num_stripes; i++)
+		h->stripes[i].num_elements = 0;
+	for (i = 0; i < num_entries; i++)
+	{
+		hash = hash_function(people[i].first_name, people[i].last_name);
+		s = stripe_for(h, hash);
+		p = slab_alloc(s->pool);
+		memcpy(p, &people[i], sizeof(struct person));
+		chain_insert(&b->heads[hash & (length - 1)], p);
+		s->num_elements++;
+	}
+	__atomic_store_n(&h->buckets, b, __ATOMIC_RELEASE);
+
+	epoch = h->rcu ? retire_epoch() : 0;
+	for (i = 0; i < old->length; i++)
+	{
+		for (current_node = old->heads[i]; current_node != NULL; current_node = next)
+		{
+			next = current_node->next;
+			s = stripe_for(h, hash_function(current_node->first_name, current_node->last_name));
+			retire_person(h, s, current_node, epoch);
+		}
+	}
+	retire_buckets(h, old, epoch);
+
+	unlock_all(h);
+
+	free(people);
+	return num_entries;
+}
+
+void print_table(struct hashtable* h)
+{
+	int i;
+	struct buckets* b;
+	struct person* current_node;
+
+	// Printing walks every bucket, so hold the whole table still
+	for (i = 0; i < h->num_stripes; i++)
+		pthread_rwlock_rdlock(&h->stripes[i].lock);
+
+	b = h->buckets;
+	for (i = 0; i < b->length; i++)
+	{
+		current_node = b->heads[i];
+		if (current_node == NULL)
+			continue;
+
+		printf("Hash index %d (stripe %d) we have:\n", i, i & (h->num_stripes - 1));
+		while (current_node != NULL)
+		{
+			printf("%s %s ID: %d\n", current_node->first_name, current_node->last_name, current_node->id);
+			current_node = current_node->next;
+		}
+		printf("\n");
+	}
+
+	for (i = h->num_stripes - 1; i >= 0; i--)
+		pthread_rwlock_unlock(&h->stripes[i].lock);
+}
+
+// No other thread may be using the table anymore
+void delete_hashtable(struct hashtable* h)
+{
+	struct retired_buckets* old;
+	int i;
+
+	// Every person, retired or not, goes away with their stripe's slab
+	for (i = 0; i < h->num_stripes; i++)
+	{
+		slab_destroy(h->stripes[i].pool);
+		free(h->stripes[i].retired);
+		pthread_rwlock_destroy(&h->stripes[i].lock);
+	}
+	while (h->retired_buckets != NULL)
+	{
+		old = h->retired_buckets;
+		h->retired_buckets = old->next;
+		free(old->b);
+		free(old);
+	}
+	free(h->stripes);
+	free(h->buckets);
+	free(h);
+}
+
+// What each benchmark thread gets to work with
+struct bench_thread {
+	pthread_t thread;
+	struct hashtable* h;
+	char (*names)[2][MAX_LEN]; // First and last name of every person in the table
+	int num_people;
+	int write_percent;
+	atomic_int* stop;
+	uint64_t rng;
+	long ops;
+};
+
+// Run random operations until told to stop. A write removes someone and
+// puts them straight back, so the table stays the same size.
+static void* bench_worker(void* arg)
+{
+	struct bench_thread* b = arg;
+	int ids[4];
+	int i;
+	long ops = 0;
+
+	while (!atomic_load_explicit(b->stop, memory_order_relaxed))
+	{
+		// xorshift, rand() takes a global lock in some C libraries
+		b->rng ^= b->rng << 13;
+		b->rng ^= b->rng >> 7;
+		b->rng ^= b->rng << 17;
+		i = (int)((b->rng >> 8) % b->num_people);
+
+		if ((int)(b->rng % 100) < b->write_percent)
+		{
+			if (remove_person(b->h, b->names[i][0], b->names[i][1], i))
+				insert(b->h, b->names[i][0], b->names[i][1], i);
+		}
+		else
+			lookup(b->h, b->names[i][0], b->names[i][1], ids, 4);
+		ops++;
+	}
+
+	b->ops = ops;
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run num_threads threads against h for the given time, returns operations per second
+static double bench_run(struct hashtable* h, char (*names)[2][MAX_LEN], int num_people,
+						int num_threads, int write_percent, int seconds)
+{
+	struct bench_thread* threads;
+	atomic_int stop = 0;
+	double start, elapsed;
+	long total = 0;
+	int i;
+
+	threads = malloc(num_threads * sizeof(struct bench_thread));
+	start = now_seconds();
+	for (i = 0; i < num_threads; i++)
+	{
+		threads[i].h = h;
+		threads[i].names = names;
+		threads[i].num_people = num_people;
+		threads[i].write_percent = write_percent;
+		threads[i].stop = &stop;
+		threads[i].rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+		pthread_create(&threads[i].thread, NULL, bench_worker, &threads[i]);
+	}
+
+	sleep(seconds);
+	atomic_store(&stop, 1);
+
+	for (i = 0; i < num_threads; i++)
+	{
+		pthread_join(threads[i].thread, NULL);
+		total += threads[i].ops;
+	}
+	elapsed = now_seconds() - start;
+
+	free(threads);
+	return total / elapsed;
+}
+
+// Fill three tables with generated people, one with a single lock, one with
+// NUM_STRIPES of them and one in RCU mode, then time them all on 1, 2, 4, ...
+// threads up to the core count
+void benchmark(int num_people, int seconds_per_run, int write_percent)
+{
+	char (*names)[2][MAX_LEN];
+	struct hashtable* tables[3];
+	double single, striped, rcu;
+	long cores;
+	int i, num_threads;
+
+	if (num_people <= 0)
+		return;
+
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1)
+		cores = 1;
+
+	names = malloc(num_people * sizeof(*names));
+	tables[0] = new_hashtable(1, 0);
+	tables[1] = new_hashtable(NUM_STRIPES, 0);
+	tables[2] = new_hashtable(NUM_STRIPES, 1);
+	for (i = 0; i < num_people; i++)
+	{
+		sprintf(names[i][0], "first%d", i);
+		sprintf(names[i][1], "last%d", i % 1000);
+		insert(tables[0], names[i][0], names[i][1], i);
+		insert(tables[1], names[i][0], names[i][1], i);
+		insert(tables[2], names[i][0], names[i][1], i);
+	}
+
+	printf("\n%d people, %d%% writes, %ld cores\n", num_people, write_percent, cores);
+	printf("threads   1 lock (ops/sec)   %d stripes (ops/sec)   RCU (ops/sec)\n", NUM_STRIPES);
+	for (num_threads = 1; ; num_threads *= 2)
+	{
+		if (num_threads > cores)
+			num_threads = cores;
+
+		single = bench_run(tables[0], names, num_people, num_threads, write_percent, seconds_per_run);
+		striped = bench_run(tables[1], names, num_people, num_threads, write_percent, seconds_per_run);
+		rcu = bench_run(tables[2], names, num_people, num_threads, write_percent, seconds_per_run);
+		printf("%7d   %16.0f   %20.0f   %13.0f\n", num_threads, single, striped, rcu);
+
+		if (num_threads == cores)
+			break;
+	}
+	printf("\n");
+
+	delete_hashtable(tables[0]);
+	delete_hashtable(tables[1]);
+	delete_hashtable(tables[2]);
+	free(names);
+}
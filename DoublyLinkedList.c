@@ -7,6 +7,7 @@
 ** Delete: O(n) (This is assuming we are deleting a name from the list, we don't know where it
 **				 is thus we need to traverse the list till we find it
 ** Search: O(n) (See above, because search is O(n) is why insert is O(n) for insert and delete)
+** Bulk load: O(n) for names that are already sorted (see insert_sorted)
 **
 ** Benefit over a Singly Linked List is that given a pointer N, we can follow links in either 
 ** direction (for example my print functions). We can also insert or delete a node either before
@@ -16,84 +17,171 @@
 ** complexity for deletion O(1) thus making this more ideal than an array. 
 ** Also, if the list was unsorted our time complexity would speed up to O(1) because
 ** we would just insert the new node at the beginning of the list.
+**
+** The list also keeps its tail and how many nodes it has, so appending, removing the
+** last name, printing backwards and asking for the size are all O(1). On top of the
+** sorted operations there are node handle operations: insert_before, insert_after and
+** unlink_node work on a node the caller already has in O(1), and splice moves a run of
+** nodes to another spot (or another list). Those put nodes exactly where they're told,
+** so a list used that way is kept in whatever order the caller wants (an LRU list, say)
+** instead of sorted. Lists made with create_list_sharing share one slab and name pool,
+** so nodes can be spliced between them without copying and handles stay good.
+**
+** Nodes point at the list's interned copy of their name (see Intern.h) instead of
+** holding a 100 char array, so repeated names are stored once and finding the node
+** to delete only needs a pointer compare per node.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "Slab.h"
+#include "Intern.h"
 
 #define MAX_LENGTH 100
 
 struct list {
 	struct node* head;
+	struct node* tail;
+	int count;         // Number of nodes
+	struct slab* pool; // Nodes come from here if the list opted into a slab
+	struct intern_pool* names; // Every node's name is this pool's copy
+	int* users;        // Lists sharing pool and names, this one included
 };
 struct node {
-	char name[MAX_LENGTH];
+	const char* name; // Interned, so equal names are the same pointer
 	struct node* next;
 	struct node* prev;
 };
 
-struct list* create_list(void);
+struct list* create_list(int use_slab);
+struct list* create_list_sharing(struct list* other);
 void insert(struct list* linked_list, char name[]);
 void print_list(struct list* linked_list);
 void print_list_reverse(struct list* linked_list); // FOR DEBUGGING 
 int delete_node(struct list* linked_list, char name[]);
 void delete_list(struct list* linked_list);
+void insert_sorted(struct list* linked_list, char* names[], int count);
+int load_file(struct list* linked_list, const char* filename);
+struct node* insert_before(struct list* linked_list, struct node* at, char name[]);
+struct node* insert_after(struct list* linked_list, struct node* at, char name[]);
+void unlink_node(struct list* linked_list, struct node* node);
+struct node* splice(struct list* to, struct node* at, struct list* from, struct node* first, struct node* last);
+struct node* append(struct list* linked_list, char name[]);
+const char* pop_back(struct list* linked_list);
+int list_size(struct list* linked_list);
 
 // Create the new linked list.
 // Allocate the memory for it.
 // Initialize the head to NULL.
-struct list* create_list(void)
+// Give it its own slab of nodes if use_slab is set.
+struct list* create_list(int use_slab)
 {
 	struct list* new_list;	
 	new_list = malloc(sizeof(struct list));
 	new_list->head = NULL;
+	new_list->tail = NULL;
+	new_list->count = 0;
+	new_list->pool = use_slab ? slab_create(sizeof(struct node)) : NULL;
+	new_list->names = intern_create();
+	new_list->users = malloc(sizeof(int));
+	*new_list->users = 1;
 	return new_list;
 }
 
-int delete_node(struct list* linked_list, char name[])
+// Create a new empty list that shares other's slab and name pool, so nodes
+// can be spliced between the two (see splice). The pools go away with the
+// last list using them.
+struct list* create_list_sharing(struct list* other)
 {
-	struct node* current_node;
-	struct node* temp;
+	struct list* new_list;
+	new_list = malloc(sizeof(struct list));
+	new_list->head = NULL;
+	new_list->tail = NULL;
+	new_list->count = 0;
+	new_list->pool = other->pool;
+	new_list->names = other->names;
+	new_list->users = other->users;
+	(*new_list->users)++;
+	return new_list;
+}
+
+// Allocate a node from the list's slab, or malloc if it doesn't have one,
+// holding the list's copy of name
+static struct node* new_node(struct list* linked_list, const char* name)
+{
+	struct node* node;
 	
-	// Case: List is empty
-	if (linked_list->head == NULL)
-			return 0;
+	if (linked_list->pool != NULL)
+		node = slab_alloc(linked_list->pool);
+	else
+		node = malloc(sizeof(struct node));
+	node->name = intern(linked_list->names, name);
+	return node;
+}
+
+// Give a node back to wherever it was allocated from
+static void release_node(struct list* linked_list, struct node* node)
+{
+	if (linked_list->pool != NULL)
+		slab_free(linked_list->pool, node);
+	else
+		free(node);
+}
+
+// Hook node into the list right before at, or at the end if at is NULL
+static void link_before(struct list* linked_list, struct node* at, struct node* node)
+{
+	node->next = at;
+	node->prev = at == NULL ? linked_list->tail : at->prev;
 	
-	// Case: First node in the list is equal to the name
-	//       that we wish to delete.
-	if (strcmp(linked_list->head->name, name) == 0)
-	{
-		temp = linked_list->head;
-		
-		if (linked_list->head->next != NULL)
-			linked_list->head->next->prev = NULL;
-		
-		linked_list->head = linked_list->head->next;
-		free(temp);
-		return 1;
-	}
+	if (node->prev != NULL)
+		node->prev->next = node;
+	else
+		linked_list->head = node;
+	
+	if (at != NULL)
+		at->prev = node;
+	else
+		linked_list->tail = node;
+	
+	linked_list->count++;
+}
 
-	current_node = linked_list->head;
+// Unhook the nodes from first through last, leaving them linked to each other.
+// Doesn't touch the count, the caller knows how many it took out.
+static void unlink_range(struct list* linked_list, struct node* first, struct node* last)
+{
+	if (first->prev != NULL)
+		first->prev->next = last->next;
+	else
+		linked_list->head = last->next;
+	
+	if (last->next != NULL)
+		last->next->prev = first->prev;
+	else
+		linked_list->tail = first->prev;
+}
 
-	while (current_node != NULL)
+int delete_node(struct list* linked_list, char name[])
+{
+	struct node* current_node;
+	const char* interned;
+	
+	// Case: The name was never interned, so no node can have it
+	interned = intern_find(linked_list->names, name);
+	if (interned == NULL)
+		return 0;
+	
+	// Handle operations can leave the list unsorted, so don't stop early
+	for (current_node = linked_list->head; current_node != NULL; current_node = current_node->next)
 	{
-		if (strcmp(current_node->name, name) == 0)
+		if (current_node->name == interned)
 		{
-			temp = current_node;
-			
-			if (current_node->next != NULL)
-			{
-				current_node->next->prev = current_node->prev;
-				current_node->prev->next = current_node->next;
-			}
-			else
-				current_node->prev->next = NULL;
-			
-			free(temp);
+			unlink_node(linked_list, current_node);
 			return 1;
 		}
-		current_node= current_node->next;
 	}
 	return 0;
 }
@@ -101,54 +189,101 @@ int delete_node(struct list* linked_list, char name[])
 // Insert node into linked list in lexicographic order
 void insert(struct list* linked_list, char name[])
 {
-	struct node* new_node;
-	new_node = malloc(sizeof(struct node));
-	strcpy(new_node->name, name);
-	new_node->next = NULL;
-	new_node->prev = NULL;
-
-	// Base Case: List is empty
-	if (linked_list->head == NULL)
-	{
-		linked_list->head = new_node;
-		return;
-	}
-	
 	struct node* current_node;
+	
+	// Find the first node whose name comes after the new name,
+	// the new node goes right before it (or at the end if there's none)
 	current_node = linked_list->head;
+	while (current_node != NULL && strcmp(current_node->name, name) <= 0)
+		current_node = current_node->next;
+	
+	link_before(linked_list, current_node, new_node(linked_list, name));
+}
+
+// Put a new node for name right before at (at the end of the list if at is NULL)
+// and return it. The list isn't kept sorted, the node goes exactly there.
+struct node* insert_before(struct list* linked_list, struct node* at, char name[])
+{
+	struct node* node = new_node(linked_list, name);
+	
+	link_before(linked_list, at, node);
+	return node;
+}
+
+// Put a new node for name right after at (at the front of the list if at is NULL)
+struct node* insert_after(struct list* linked_list, struct node* at, char name[])
+{
+	return insert_before(linked_list, at == NULL ? linked_list->head : at->next, name);
+}
+
+// Take a node out of the list and free it, no searching needed
+void unlink_node(struct list* linked_list, struct node* node)
+{
+	unlink_range(linked_list, node, node);
+	linked_list->count--;
+	release_node(linked_list, node);
+}
+
+// Move the nodes from first through last (first can't come after last) out of
+// from and put them, in the same order, right before at in to (at the end if at
+// is NULL). at can't be one of the nodes being moved. Returns the first moved
+// node, or NULL if to and from don't share their pools (see create_list_sharing).
+//
+// The nodes are just relinked, so every handle stays good. Within one list
+// that's O(1), moving to another list also counts the nodes moved, O(k).
+struct node* splice(struct list* to, struct node* at, struct list* from, struct node* first, struct node* last)
+{
+	struct node* node;
+	int moved = 1;
+	
+	// Case: The nodes and their names belong to another list's pools
+	if (to != from && (to->pool != from->pool || to->names != from->names))
+		return NULL;
 	
-	// Case: Name comes before first name in list
-	if (strcmp(linked_list->head->name, name) > 0)
+	if (to != from)
 	{
-		new_node->next = current_node;
-		linked_list->head = new_node;
-		current_node->prev = new_node;
-		return; 
+		for (node = first; node != last; node = node->next)
+			moved++;
+		from->count -= moved;
+		to->count += moved;
 	}
 	
-	// Case: Name we wish to insert comes before the current node OR
-	//       if the current node's next node is null then we've reached
-	//       the end of the list
-	while (current_node != NULL)
-	{	
-		// Case: Name comes before current node's name
-		if (strcmp(current_node->name, name) > 0)
-		{
-			new_node->next = current_node;
-			new_node->prev = current_node->prev;
-			current_node->prev->next = new_node;
-			current_node->prev = new_node;
-			return;
-		}
-		// Case: We've reached the end of the list
-		else if (current_node->next == NULL)
-		{
-			current_node->next = new_node;
-			new_node->prev = current_node;
-			return;
-		}
-		current_node = current_node->next;
-	}
+	unlink_range(from, first, last);
+	first->prev = at == NULL ? to->tail : at->prev;
+	last->next = at;
+	if (first->prev != NULL)
+		first->prev->next = first;
+	else
+		to->head = first;
+	if (at != NULL)
+		at->prev = last;
+	else
+		to->tail = last;
+	return first;
+}
+
+// Add a name at the end of the list
+struct node* append(struct list* linked_list, char name[])
+{
+	return insert_before(linked_list, NULL, name);
+}
+
+// Remove the last node, returns its name (the pool's copy, which stays
+// around) or NULL if the list is empty
+const char* pop_back(struct list* linked_list)
+{
+	const char* name;
+	
+	if (linked_list->tail == NULL)
+		return NULL;
+	name = linked_list->tail->name;
+	unlink_node(linked_list, linked_list->tail);
+	return name;
+}
+
+int list_size(struct list* linked_list)
+{
+	return linked_list->count;
 }
 
 // Delete the entire list
@@ -156,6 +291,29 @@ void delete_list(struct list* linked_list)
 {
 	struct node* temp;
 	
+	// Case: Other lists still use the pools, so only give back this list's nodes
+	if (--*linked_list->users > 0)
+	{
+		while (linked_list->head != NULL)
+		{
+			temp = linked_list->head;
+			linked_list->head = linked_list->head->next;
+			release_node(linked_list, temp);
+		}
+		free(linked_list);
+		return;
+	}
+	free(linked_list->users);
+	
+	// With a slab every node goes away at once with the slab
+	if (linked_list->pool != NULL)
+	{
+		slab_destroy(linked_list->pool);
+		intern_destroy(linked_list->names);
+		free(linked_list);
+		return;
+	}
+	
 	// Cycle through and free all nodes until head is null
 	while (linked_list->head != NULL)
 	{
@@ -165,9 +323,69 @@ void delete_list(struct list* linked_list)
 	}
 	
 	// Finally free the linked_list
+	intern_destroy(linked_list->names);
 	free(linked_list);
 }
 
+// Insert name somewhere after the node after (or anywhere if after is NULL),
+// keeping the list sorted, and return the new node. Feeding each new node
+// back in as after makes it the tail of a batch being appended, so for
+// sorted names the next one usually goes right after it with no searching.
+static struct node* insert_in_order(struct list* linked_list, struct node* after, char name[])
+{
+	struct node* node;
+	struct node* next;
+	
+	node = new_node(linked_list, name);
+	
+	// Case: Name comes before after, so start over from the head
+	if (after != NULL && strcmp(after->name, name) > 0)
+		after = NULL;
+	
+	next = after == NULL ? linked_list->head : after->next;
+	while (next != NULL && strcmp(next->name, name) < 0)
+		next = next->next;
+	
+	link_before(linked_list, next, node);
+	return node;
+}
+
+// Add count names at once. If the names are already sorted the whole
+// batch is merged into the list in one pass, O(n + count) instead of a
+// full scan per name. Names that are out of order still end up in the
+// right place, they just cost a scan from the head.
+void insert_sorted(struct list* linked_list, char* names[], int count)
+{
+	struct node* tail = NULL;
+	int i;
+	
+	for (i = 0; i < count; i++)
+		tail = insert_in_order(linked_list, tail, names[i]);
+}
+
+// Same as insert_sorted but streams the names out of a file, one per word.
+// Returns the number of names read, or -1 if the file couldn't be opened.
+int load_file(struct list* linked_list, const char* filename)
+{
+	FILE* fp;
+	struct node* tail = NULL;
+	char name[MAX_LENGTH];
+	int count = 0;
+	
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	
+	while (fscanf(fp, "%99s", name) == 1)
+	{
+		tail = insert_in_order(linked_list, tail, name);
+		count++;
+	}
+	
+	fclose(fp);
+	return count;
+}
+
 void print_list(struct list* linked_list)
 {
 	struct node* current_node;
@@ -199,13 +417,8 @@ void print_list_reverse(struct list* linked_list)
 	if (linked_list->head == NULL)
 		printf("There is nothing currently in the list!\n");
 
-	current_node = linked_list->head;
-		
-	// Let's move to the end of the list
-	while (current_node->next != NULL)
-		current_node = current_node->next;
-	
-	// Then let's backtrack and print
+	// Start at the end of the list and backtrack
+	current_node = linked_list->tail;
 	while (current_node != NULL)
 	{
 		printf("%s ", current_node->name);
@@ -216,11 +429,14 @@ void print_list_reverse(struct list* linked_list)
 
 int main() 
 {
-	int choice;
+	int choice, count;
 	char name[MAX_LENGTH];
+	char filename[256];
+	const char* last;
+	clock_t start;
 	
 	struct list* linked_list;
-	linked_list = create_list();
+	linked_list = create_list(1);
 	
 	printf("Welcome to the names database!\n");
 	printf("We're happy to store all the names you like.\n");
@@ -231,6 +447,11 @@ int main()
 		printf("2. Print the list\n");
 		printf("3. Delete name from the list\n");
 		printf("4. DEBUG: Print list in reverse order\n");
+		printf("5. Print allocation stats\n");
+		printf("6. Load names from a sorted file\n");
+		printf("7. Add a name to the end of the list\n");
+		printf("8. Remove the last name in the list\n");
+		printf("9. Print the number of names\n");
 		printf("0. Exit the program\n");
 		scanf("%d", &choice);
 		
@@ -253,6 +474,38 @@ int main()
 		}
 		else if (choice == 4)
 			print_list_reverse(linked_list);
+		else if (choice == 5)
+		{
+			slab_print_stats(linked_list->pool, "Node");
+			intern_print_stats(linked_list->names, "Name");
+		}
+		else if (choice == 6)
+		{
+			printf("Please enter the file you wish to load\n");
+			scanf("%255s", filename);
+			start = clock();
+			count = load_file(linked_list, filename);
+			if (count < 0)
+				printf("Sorry I could not open %s\n", filename);
+			else
+				printf("Loaded %d names in %.3f ms\n", count, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+		}
+		else if (choice == 7)
+		{
+			printf("Please enter the name you wish to add to the end\n");
+			scanf("%s", name);
+			append(linked_list, name);
+		}
+		else if (choice == 8)
+		{
+			last = pop_back(linked_list);
+			if (last != NULL)
+				printf("Succesfully removed %s from the end of the list!\n", last);
+			else
+				printf("There is nothing currently in the list!\n");
+		}
+		else if (choice == 9)
+			printf("There are %d names in the list\n", list_size(linked_list));
 	} while (choice != 0);
 	
 	delete_list(linked_list);
@@ -12,10 +12,20 @@
 **                to insert the element at the end of the chain.
 ** Delete: O(1) - Assuming we don't have huge chains to search
 ** Delete: O(n) - Worst case, we have to search a chain at the hash index.
+** By ID:  O(1) - Lookup and delete by ID go through the ID index (see below)
+** Prefix: O(k + r) - Last name and first name prefix searches, k is the length of what
+**                    was typed and r the number of people found (see below)
 **
-** Notes: At the moment this hash table is going to hit worst case scenarios the majority of the time
-**        due to the size of the hash table along with the number of inputs. The main purpose of
-**        this hash table is to demonstrate chaining versus optimizing the time complexity. 
+** Notes: The table starts out small (INITIAL_LEN buckets) to exercise chaining, then grows
+**        once the average chain gets longer than MAX_LOAD and shrinks again once it drops
+**        below MIN_LOAD. Resizing is incremental: the old bucket array is kept around and
+**        every insert/remove migrates at most REHASH_STEP of its buckets, so no single
+**        call ever pays for rehashing the whole table.
+**
+**        Passing "swiss" on the command line stores people with open addressing instead
+**        (swiss table style). One control byte per slot holds 7 bits of the hash, and a
+**        whole group of control bytes is compared at once with SSE2/AVX2, so most probes
+**        only touch the control bytes and the slot holding the full hash.
 **
 ** Hash Table stores people
 ** People have first and last names, sometimes the same.
@@ -28,79 +38,312 @@
 ** Next Line is last name.
 ** Next line is unique ID.
 ** Repeat.
+**
+** The file is loaded with mmap instead of fscanf. It is scanned in place for whitespace
+** 16 bytes at a time (SSE2), every name gets a '\0' written over the whitespace after it,
+** and people just point at their names inside the mapping instead of copying them into
+** fixed size arrays. The table is sized for the whole file up front so loading never
+** has to resize. That makes a person 40 bytes instead of 208, and the names themselves
+** take no more room than they do in the file.
+**
+** Every person keeps the hash of their name and the length of both names, worked out
+** once when they're inserted. A probe only looks at the characters of a name once the
+** hash and lengths already match, compares them ignoring case without copying anything,
+** and resizing never hashes a name again. Lookups don't change the table at all.
+**
+** People are also indexed by ID, in a small open addressing table of pointers to the same
+** people (linear probing, kept at most half full). Every insert and remove keeps it up to
+** date, so options 7 and 8 look up and remove someone by ID alone. Removing by ID gets the
+** person from the index and then uses their cached hash to go straight to their chain or
+** slot, so no name is ever hashed. The database file is supposed to have unique ID's, but
+** if it doesn't the index holds all of them, and lookups by ID print everyone sharing one.
+**
+** Options 9 and 10 find everyone with a last name, or everyone whose first name starts
+** with some letters, without scanning the table. They go through two radix trees (tries
+** with single child chains squashed into one edge): one over "last name, first name" and
+** one over "first name, last name", both lowercased with a '\1' between the names so that
+** "smith" sorts ahead of "smithers". A search walks down the letters typed and then lists
+** everything under that node in order. The trees are only built the first time one of
+** these searches comes up, since most runs never ask, and from then on every insert and
+** remove keeps them up to date along with the ID index.
+**
+** Option 6 saves the table to HashPeople.snap, a binary snapshot holding a bucket array,
+** fixed size records that link to each other and to their names by offset, and a pool of
+** '\0' terminated names. On the next start the snapshot is mapped in (if it isn't older
+** than HashPeople.txt) and lookups walk it right where it sits, so restarting costs the
+** page faults of whatever gets touched instead of parsing and hashing every person. The
+** first change to the table thaws the snapshot into ordinary people.
+**
+** Passing "parallel" on the command line loads the file on every core instead: the text
+** is cut into chunks on record boundaries, each thread parses its chunk and sorts its
+** people by which thread owns their bucket (or slot group), and then every thread links
+** in the people for its own part of the table, so no locks are needed anywhere.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "Slab.h"
+
+// The open addressing backend scans its control bytes a whole group
+// at a time, 32 with AVX2 and 16 with SSE2 (or the plain C fallback).
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GROUP_WIDTH 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GROUP_WIDTH 16
+#else
+#define GROUP_WIDTH 16
+#endif
 
-// Max length of a person's first or last name.
+// Max length of a person's first or last name. Longer
+// names in the database file get cut off.
 #define MAX_LEN 100
 // Initial size of table will be 7, let's
 // keep it small to test our collision resolution
 // policy of chaining using a singly linked list.
 #define INITIAL_LEN 7
+// Grow when the average chain is longer than MAX_LOAD people,
+// shrink when it falls below MIN_LOAD.
+#define MAX_LOAD 2.0
+#define MIN_LOAD 0.25
+// Number of old buckets migrated per operation while resizing.
+#define REHASH_STEP 4
+// Control bytes of the open addressing backend. Full slots store the low
+// 7 bits of their hash, so anything with the high bit set is free.
+#define CTRL_EMPTY ((signed char)-128)
+#define CTRL_DELETED ((signed char)-2)
+// Slots in a new table's ID index, it doubles whenever it would get over half full
+#define INITIAL_ID_CAPACITY 16
+// Goes between the two names in a name index key, it sorts before any letter
+#define NAME_SEPARATOR '\1'
 
 struct person {
-	char first_name[MAX_LEN];
-	char last_name[MAX_LEN];
+	char* first_name; // Point into the text of the people file
+	char* last_name;
+	uint64_t hash;    // hash_function of the names, cached by insert
+	unsigned short first_length; // Names are never longer than MAX_LEN - 1
+	unsigned short last_length;
 	int id;
 	struct person* next;
 };
 
+// A name being looked for, with what a person has cached worked out the same way
+struct name_key {
+	const char* first_name;
+	const char* last_name;
+	uint64_t hash;
+	size_t first_length;
+	size_t last_length;
+};
+
+// A hash function gets both names separately plus a seed. Case is
+// ignored so "John Smith" and "john smith" hash the same.
+typedef uint64_t (*hash_fn)(const char* first_name, const char* last_name, uint64_t seed);
+
+// Tables either chain people off a bucket array or keep them in an
+// open addressing (swiss table style) slot array.
+enum table_backend {
+	BACKEND_CHAINED,
+	BACKEND_SWISS
+};
+
+// A slot of the open addressing backend. The hash is kept with the
+// pointer so we only go out to the person (and its names) on a match.
+struct slot {
+	uint64_t hash;
+	struct person* p;
+};
+
 struct hashtable
 {
     struct person** store;
     int length; // Length of the array
     int num_elements;
+    // While a resize is in progress the people not yet migrated live in
+    // old_store. Buckets below rehash_index have already been moved.
+    struct person** old_store;
+    int old_length;
+    int rehash_index;
+    hash_fn hash;
+    uint64_t seed;
+    enum table_backend backend;
+    // Open addressing backend: one control byte per slot, a power of two
+    // number of slots, and how many EMPTY slots we may still fill.
+    signed char* ctrl;
+    struct slot* slots;
+    int capacity;
+    int growth_left;
+    struct slab* pool; // People come from here if the table opted into a slab
+    // Set while the table is still answering lookups out of a snapshot
+    struct snapshot_header* frozen;
+    // ID index: open addressing over the same people, NULL for a free slot.
+    // A power of two number of slots, never more than half of them used.
+    struct person** by_id;
+    int id_capacity;
+    int id_count;
+    // Name indexes for prefix searches, NULL until the first search builds them
+    struct radix_node* by_last;  // Keyed by last name, then first name
+    struct radix_node* by_first; // Keyed by first name, then last name
+};
+
+// A node of a name index. The edge coming into it from its parent is
+// labelled with one or more characters, so a chain of nodes that would
+// each have a single child is just one node with a longer label.
+struct radix_node {
+	char* label;
+	int label_length;
+	struct radix_node** children; // Sorted by the first character of their labels
+	int num_children;
+	struct person** people;       // Everyone whose whole key ends at this node
+	int num_people;
+	int people_capacity;
+};
+
+// The text of a people file. It has to stay around for as long as
+// the people loaded from it, since their names point into it.
+struct people_file {
+	char* text;
+	size_t size;
+	int mapped; // From mmap, otherwise it was read into a malloced buffer
+};
+
+// Snapshot file layout, in native byte order:
+//   header
+//   uint32_t buckets[num_buckets]           index of the first record in each bucket
+//   struct snapshot_record[num_records]     a bucket's records are next to each other
+//   char pool[pool_size]                    '\0' terminated names
+#define SNAPSHOT_MAGIC "HPSNAP"
+#define SNAPSHOT_VERSION 1
+// Marks an empty bucket or the end of a chain
+#define SNAPSHOT_NONE 0xffffffffu
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t hash_id; // Which of snapshot_hashes placed the people
+	uint64_t seed;
+	uint32_t num_buckets;
+	uint32_t num_records;
+	uint64_t pool_size;
+	uint64_t checksum; // Of the header (with this zeroed) and everything after it
+};
+
+struct snapshot_record {
+	uint32_t first_name; // Offsets into the name pool
+	uint32_t last_name;
+	int32_t id;
+	uint32_t next; // Index of the next record in the bucket
 };
 
 
-struct hashtable* new_hashtable(); 
+struct hashtable* new_hashtable(enum table_backend backend, int use_slab); 
+struct person* new_person(struct hashtable* h);
 void insert(struct hashtable* h, struct person* p);
-int hash_function(char first_name[], char last_name[]); 
+uint64_t hash_function(struct hashtable* h, char first_name[], char last_name[]); 
+int set_hash(struct hashtable* h, hash_fn hash, uint64_t seed);
+uint64_t random_seed(void);
+uint64_t hash_wy(const char* first_name, const char* last_name, uint64_t seed);
+uint64_t hash_sip(const char* first_name, const char* last_name, uint64_t seed);
+uint64_t hash_ascii_sum(const char* first_name, const char* last_name, uint64_t seed);
+void hash_report(struct hashtable* h);
 void delete_hashtable(struct hashtable* h); 
+struct people_file* load_people(struct hashtable* h, const char* filename, int* count);
+struct people_file* load_people_parallel(struct hashtable* h, const char* filename, int num_threads, int* count);
+void close_people_file(struct people_file* f);
+int save_snapshot(struct hashtable* h, const char* filename);
+struct people_file* load_snapshot(struct hashtable* h, const char* filename, int* count);
 int lookup(struct hashtable* h, char first_name[], char last_name[]);
 int remove_person(struct hashtable* h, char first_name[], char last_name[], int pid);
+int lookup_by_id(struct hashtable* h, int pid);
+int remove_by_id(struct hashtable* h, int pid);
+int lookup_last_name(struct hashtable* h, char last_name[]);
+int lookup_first_prefix(struct hashtable* h, char prefix[]);
 void print_table(struct hashtable* h);
 char * to_lowercase(char s[]);
+void resize(struct hashtable* h, int new_length);
+void rehash_step(struct hashtable* h);
+void finish_rehash(struct hashtable* h);
+static void swiss_alloc(struct hashtable* h, int capacity);
+static void swiss_rehash(struct hashtable* h, int new_capacity);
+static void swiss_insert(struct hashtable* h, struct person* p);
+static void swiss_insert_hashed(struct hashtable* h, struct person* p, uint64_t hash);
+static int swiss_find_free_in(struct hashtable* h, uint64_t hash, int part, int num_parts);
+static int swiss_lookup(struct hashtable* h, char first_name[], char last_name[]);
+static int swiss_remove(struct hashtable* h, struct name_key* key, int pid);
+static void thaw(struct hashtable* h);
+static int same_name(const char* a, const char* b);
+static int compare_names(const char* a, const char* b);
+static void cache_key(struct hashtable* h, struct person* p);
+static void make_key(struct hashtable* h, const char* first_name, const char* last_name, struct name_key* key);
+static int has_key(struct person* p, struct name_key* key);
+static void name_index_add(struct hashtable* h, struct person* p);
+static void name_index_remove(struct hashtable* h, struct person* p);
+static void radix_destroy(struct radix_node* node);
+static int gather_people(struct hashtable* h, struct person** people);
+static double now_seconds(void);
 
-int main(void)
+int main(int argc, char* argv[])
 {
-	int i, choice, num_entries, pid, seen;
-	FILE *fp;
-	char* token;
+	int choice, num_entries, pid, seen;
+	struct people_file* people_file;
+	struct stat snap_st, text_st;
+	double start, elapsed;
+	int i, swiss = 0, parallel = 0;
+	long cores;
 	char first_name[MAX_LEN];
 	char last_name[MAX_LEN];
 	
-	// Create a new hashtable
-	struct hashtable* my_hashtable = new_hashtable();
-	
-	// Open database file for reading
-	fp = fopen("HashPeople.txt", "r");
-	// How many people are we scanning in?
-	fscanf(fp, "%d", &num_entries);
-	for (i = 0; i < num_entries; i++)
+	for (i = 1; i < argc; i++)
 	{
-		struct person* new_person = malloc(sizeof(struct person));
-		fscanf(fp, "%s", new_person->first_name);
-		fscanf(fp, "%s", new_person->last_name);
-		fscanf(fp, "%d", &new_person->id);
-		new_person->next = NULL;
-		insert(my_hashtable, new_person);
+		if (strcmp(argv[i], "swiss") == 0)
+			swiss = 1;
+		else if (strcmp(argv[i], "parallel") == 0)
+			parallel = 1;
 	}
 	
+	// Create a new hashtable, chained unless "swiss" was asked for
+	struct hashtable* my_hashtable;
+	if (swiss)
+		my_hashtable = new_hashtable(BACKEND_SWISS, 1);
+	else
+		my_hashtable = new_hashtable(BACKEND_CHAINED, 1);
 	
-	if (fp == NULL)
+	// Start from the snapshot if it isn't older than the database file,
+	// otherwise load everyone from the database file
+	start = now_seconds();
+	people_file = NULL;
+	if (stat("HashPeople.snap", &snap_st) == 0 &&
+		(stat("HashPeople.txt", &text_st) != 0 || snap_st.st_mtime >= text_st.st_mtime))
+	{
+		people_file = load_snapshot(my_hashtable, "HashPeople.snap", &num_entries);
+		if (people_file == NULL)
+			printf("HashPeople.snap is damaged or out of date, loading HashPeople.txt instead\n");
+	}
+	if (people_file == NULL && parallel)
+	{
+		cores = sysconf(_SC_NPROCESSORS_ONLN);
+		people_file = load_people_parallel(my_hashtable, "HashPeople.txt", cores < 1 ? 1 : cores, &num_entries);
+	}
+	else if (people_file == NULL)
+		people_file = load_people(my_hashtable, "HashPeople.txt", &num_entries);
+	if (people_file == NULL)
 	{
 		printf("Sorry, we could not open the database file!\n");
 		return 0;
 	}
-	
-	// Close file after reading
-	fclose(fp);
-	
+	elapsed = now_seconds() - start;
+	printf("Loaded %d people in %.3f ms (%.0f people/sec)\n", num_entries, elapsed * 1000.0,
+		   elapsed > 0 ? num_entries / elapsed : 0.0);
 	
 	printf("Welcome to the HashPeople Database!\n");
 	printf("We have all sorts of people hashed in this here database\n");
@@ -112,6 +355,13 @@ int main(void)
 		printf("1. Look up by first and last name\n");
 		printf("2. Remove a person by first and last name\n");
 		printf("3. Print hash table\n");
+		printf("4. Hash distribution report\n");
+		printf("5. Print allocation stats\n");
+		printf("6. Save a snapshot for a quick restart\n");
+		printf("7. Look up by ID\n");
+		printf("8. Remove a person by ID\n");
+		printf("9. Look up everyone with a last name\n");
+		printf("10. Look up everyone whose first name starts with...\n");
 		printf("0. Exit program\n");
 		scanf("%d", &choice);
 		
@@ -121,8 +371,8 @@ int main(void)
 			scanf("%s %s", first_name, last_name);
 			
 			// Convert to all lowercase
-			strcpy(first_name, to_lowercase(first_name));
-			strcpy(last_name, to_lowercase(last_name));
+			to_lowercase(first_name);
+			to_lowercase(last_name);
 			
 			seen = lookup(my_hashtable, first_name, last_name);
 		}
@@ -138,218 +388,2254 @@ int main(void)
 		}
 		else if (choice == 3)
 			print_table(my_hashtable);
+		else if (choice == 4)
+			hash_report(my_hashtable);
+		else if (choice == 5)
+			slab_print_stats(my_hashtable->pool, "Person");
+		else if (choice == 6)
+		{
+			if (save_snapshot(my_hashtable, "HashPeople.snap"))
+				printf("Saved %d people to HashPeople.snap\n\n", my_hashtable->num_elements);
+			else
+				printf("Sorry, we could not write HashPeople.snap\n\n");
+		}
+		else if (choice == 7 || choice == 8)
+		{
+			printf("Please enter the ID\n");
+			scanf("%d", &pid);
+			
+			seen = lookup_by_id(my_hashtable, pid);
+			if (choice == 8 && seen != 0)
+			{
+				if (remove_by_id(my_hashtable, pid))
+					printf("Successfully removed ID: %d\n", pid);
+				else
+					printf("There was an error removing ID: %d\n", pid);
+			}
+		}
+		else if (choice == 9)
+		{
+			printf("Please enter the last name\n");
+			scanf("%s", last_name);
+			lookup_last_name(my_hashtable, last_name);
+		}
+		else if (choice == 10)
+		{
+			printf("Please enter the start of the first name\n");
+			scanf("%s", first_name);
+			lookup_first_prefix(my_hashtable, first_name);
+		}
 		
 	} while (choice != 0);
 	
 	delete_hashtable(my_hashtable);
+	close_people_file(people_file);
 	system("PAUSE");
 	exit(0);
 }
 
-// Create a new hash table of size INITIAL_LEN
-struct hashtable* new_hashtable() 
+// Create a new hash table of size INITIAL_LEN, or a single group
+// of slots for the open addressing backend. If use_slab is set the
+// table gets its own slab to allocate people from.
+struct hashtable* new_hashtable(enum table_backend backend, int use_slab) 
 {
 	struct hashtable* h;
 	h = malloc(sizeof(struct hashtable));
-	h->length = INITIAL_LEN;
+	h->backend = backend;
 	h->num_elements = 0;
-	// Use calloc to initialize to zeros
-	h->store = calloc(INITIAL_LEN, sizeof(struct person*));
+	h->store = NULL;
+	h->length = 0;
+	h->ctrl = NULL;
+	h->slots = NULL;
+	h->capacity = 0;
+	h->growth_left = 0;
+	if (backend == BACKEND_SWISS)
+		swiss_alloc(h, GROUP_WIDTH);
+	else
+	{
+		h->length = INITIAL_LEN;
+		// Use calloc to initialize to zeros
+		h->store = calloc(INITIAL_LEN, sizeof(struct person*));
+	}
+	h->old_store = NULL;
+	h->old_length = 0;
+	h->rehash_index = 0;
+	// Default to the fast hash, seeded so placement differs from run to run
+	h->hash = hash_wy;
+	h->seed = random_seed();
+	h->pool = use_slab ? slab_create(sizeof(struct person)) : NULL;
+	h->frozen = NULL;
+	h->id_capacity = INITIAL_ID_CAPACITY;
+	h->by_id = calloc(INITIAL_ID_CAPACITY, sizeof(struct person*));
+	h->id_count = 0;
+	h->by_last = NULL;
+	h->by_first = NULL;
 	return h;
 }
 
-// Insert a new person into the hashtable
-void insert(struct hashtable* h, struct person* p)
+// Allocate a person to be inserted into h, from h's slab if it has one
+struct person* new_person(struct hashtable* h)
+{
+	if (h->pool != NULL)
+		return slab_alloc(h->pool);
+	return malloc(sizeof(struct person));
+}
+
+// Give a removed person back to wherever they were allocated from
+static void release_person(struct hashtable* h, struct person* p)
+{
+	if (h->pool != NULL)
+		slab_free(h->pool, p);
+	else
+		free(p);
+}
+
+// Insert a person into a single chain, keeping it sorted by first name (ignoring case)
+static void chain_insert(struct person** head, struct person* p)
 {
-	int hash_index;
 	struct person* current_node;
 	
-	h->num_elements++;
-	
-	// We need to grab the hash table index using
-	// our hashing function.
-	hash_index = hash_function(p->first_name, p->last_name);
-	
-	// Now we need to insert the person into that index.
-	// First check if index is NULL, meaning nothing is there.
-	// If there is nothing there then let's put the person there.
-	if (h->store[hash_index] == NULL ||
-		strcmp(h->store[hash_index]->first_name, p->first_name) > 0)
+	// First check if the chain is empty or if the person comes
+	// before the head of the chain, if so they become the new head.
+	if (*head == NULL || compare_names((*head)->first_name, p->first_name) > 0)
 	{
-		p->next = h->store[hash_index];
-		h->store[hash_index] = p;
+		p->next = *head;
+		*head = p;
 		return;
 	}
 	
-	current_node = h->store[hash_index];
+	current_node = *head;
 	
 	// If next node is not null and the name we're inserting doesn't
 	// come before the next node's name, then go to the next node	
-	while (current_node->next != NULL && strcmp(current_node->next->first_name, p->first_name) < 0)
+	while (current_node->next != NULL && compare_names(current_node->next->first_name, p->first_name) < 0)
 		current_node = current_node->next;
 	
 	p->next = current_node->next;
 	current_node->next = p;	
 }
 
-// Hash function for generating index, utilizes ASCII sums of first + last names
-int hash_function(char first_name[], char last_name[]) 
+// Start moving everyone over to a bucket array of new_length.
+// The actual moving happens a few buckets at a time in rehash_step.
+void resize(struct hashtable* h, int new_length)
 {
-	char concat_name[MAX_LEN*2];
-	int string_sum, hash_value;
-	int i, j;
+	// Only one resize can be in flight, so finish the previous one first
+	if (h->old_store != NULL)
+		finish_rehash(h);
 	
-	// For now we will concat name to use for hash function
-	strcpy(concat_name, first_name);
-	strcat(concat_name, last_name);
-	// Now let's convert the strings to lowercase
-	strcpy(concat_name, to_lowercase(concat_name));
+	h->old_store = h->store;
+	h->old_length = h->length;
+	h->rehash_index = 0;
+	h->store = calloc(new_length, sizeof(struct person*));
+	h->length = new_length;
+}
 
-	// Now because this is a string we first need to process the text
-	// to convert it to numbers. So let's parse each individual char,
-	// summing all ASCII integers of the string.
-	j = 0;
-	string_sum = 0;
-	while (concat_name[j] != '\0')
+// Migrate up to REHASH_STEP buckets from the old array to the new one
+void rehash_step(struct hashtable* h)
+{
+	int i;
+	struct person* current_node;
+	struct person* temp;
+	
+	if (h->old_store == NULL)
+		return;
+	
+	for (i = 0; i < REHASH_STEP && h->rehash_index < h->old_length; i++)
+	{
+		current_node = h->old_store[h->rehash_index];
+		h->old_store[h->rehash_index] = NULL;
+		h->rehash_index++;
+		
+		while (current_node != NULL)
+		{
+			temp = current_node;
+			current_node = current_node->next;
+			chain_insert(&h->store[temp->hash % h->length], temp);
+		}
+	}
+	
+	// Case: Every old bucket has been moved, we can let go of the old array
+	if (h->rehash_index == h->old_length)
 	{
-		string_sum += (concat_name[j] - '0');
-		j++;
+		free(h->old_store);
+		h->old_store = NULL;
+		h->old_length = 0;
+		h->rehash_index = 0;
 	}
+}
+
+// Migrate everything that is left in the old array in one go
+void finish_rehash(struct hashtable* h)
+{
+	while (h->old_store != NULL)
+		rehash_step(h);
+}
+
+// Grow or shrink the table if the load factor left its bounds
+static void check_load(struct hashtable* h)
+{
+	if (h->num_elements > h->length * MAX_LOAD)
+		resize(h, h->length * 2 + 1);
+	else if (h->length > INITIAL_LEN && h->num_elements < h->length * MIN_LOAD)
+		resize(h, (h->length - 1) / 2 < INITIAL_LEN ? INITIAL_LEN : (h->length - 1) / 2);
+}
+
+// Collect the chains a name could live in. While resizing that can be
+// both the new bucket and an old bucket that hasn't been migrated yet.
+static int find_chains(struct hashtable* h, uint64_t hash, struct person** chains[2])
+{
+	int num_chains = 0;
 	
-	// Mod the string sum by the length of our hash table
-	hash_value = string_sum % INITIAL_LEN;
+	if (h->old_store != NULL && hash % h->old_length >= (uint64_t)h->rehash_index)
+		chains[num_chains++] = &h->old_store[hash % h->old_length];
+	chains[num_chains++] = &h->store[hash % h->length];
 	
-	return hash_value;
+	return num_chains;
 }
 
-// Prints all people in the database matching the first and last name
-int lookup(struct hashtable* h, char first_name[], char last_name[])
+// Home slot of an ID in the ID index. ID's are often dense, so mix the
+// high bits back down before masking.
+static int id_home(struct hashtable* h, int pid)
 {
-	int hash_index;
-	int seen;
-	struct person* current_node;
-	char temp_first[MAX_LEN];
-	char temp_last[MAX_LEN];
+	uint32_t x = (uint32_t)pid * 0x9e3779b1u;
+	return (int)((x ^ (x >> 16)) & (h->id_capacity - 1));
+}
+
+// Move the ID index over to capacity slots
+static void id_index_resize(struct hashtable* h, int capacity)
+{
+	struct person** old_by_id = h->by_id;
+	int old_capacity = h->id_capacity;
+	int i, slot;
 	
-	// Grab hash index	
-	hash_index = hash_function(first_name, last_name);
+	h->by_id = calloc(capacity, sizeof(struct person*));
+	h->id_capacity = capacity;
+	for (i = 0; i < old_capacity; i++)
+	{
+		if (old_by_id[i] == NULL)
+			continue;
+		slot = id_home(h, old_by_id[i]->id);
+		while (h->by_id[slot] != NULL)
+			slot = (slot + 1) & (capacity - 1);
+		h->by_id[slot] = old_by_id[i];
+	}
+	free(old_by_id);
+}
 
-	current_node = h->store[hash_index];
-	seen = 0;
-	printf("\n");
-	while (current_node != NULL) 
-	{	
-		if (strcmp(strcpy(temp_first, to_lowercase(current_node->first_name)), first_name) == 0 &&
-			strcmp(strcpy(temp_last, to_lowercase(current_node->last_name)), last_name) == 0)
-		{
-			seen = 1;
-			printf("Found name: %s %s  ", current_node->first_name, current_node->last_name);
-			printf("Personal ID: %d\n", current_node->id);
-		}
-		current_node = current_node->next;
-	}	
+// Make room for n more people in the ID index
+static void id_index_reserve(struct hashtable* h, int n)
+{
+	int capacity = h->id_capacity;
 	
-	if (seen == 0)
+	while ((h->id_count + n) * 2 > capacity)
+		capacity *= 2;
+	if (capacity != h->id_capacity)
+		id_index_resize(h, capacity);
+}
+
+static void id_index_add(struct hashtable* h, struct person* p)
+{
+	int slot;
+	
+	id_index_reserve(h, 1);
+	slot = id_home(h, p->id);
+	while (h->by_id[slot] != NULL)
+		slot = (slot + 1) & (h->id_capacity - 1);
+	h->by_id[slot] = p;
+	h->id_count++;
+}
+
+// First person in the ID index with the ID, or NULL if there is nobody
+static struct person* id_index_find(struct hashtable* h, int pid)
+{
+	int slot;
+	
+	for (slot = id_home(h, pid); h->by_id[slot] != NULL; slot = (slot + 1) & (h->id_capacity - 1))
+		if (h->by_id[slot]->id == pid)
+			return h->by_id[slot];
+	return NULL;
+}
+
+// Take a person out of the ID index. There are no tombstones: people
+// further along the run get shifted back into the hole, unless that
+// would put them in front of their home slot.
+static void id_index_remove(struct hashtable* h, struct person* p)
+{
+	int mask = h->id_capacity - 1;
+	int slot, next, home;
+	
+	slot = id_home(h, p->id);
+	while (h->by_id[slot] != p)
+		slot = (slot + 1) & mask;
+	
+	for (next = (slot + 1) & mask; h->by_id[next] != NULL; next = (next + 1) & mask)
 	{
-		printf("I'm sorry, I could not find %s %s in the database\n\n", first_name, last_name);
-		return 0;
+		home = id_home(h, h->by_id[next]->id);
+		// Case: Home is cyclically after the hole, so the person has to stay put
+		if (((next - home) & mask) < ((next - slot) & mask))
+			continue;
+		h->by_id[slot] = h->by_id[next];
+		slot = next;
 	}
-	printf("\n");
-	return 1;
+	h->by_id[slot] = NULL;
+	h->id_count--;
 }
 
-int remove_person(struct hashtable* h, char first_name[], char last_name[], int pid)
+// Insert a new person into the hashtable
+void insert(struct hashtable* h, struct person* p)
 {
-	// if successfully removed return 1
-	int hash_index;
-	struct person* current_node;
-	struct person* temp;
-	char temp_first[MAX_LEN];
-	char temp_last[MAX_LEN];
+	thaw(h);
+	cache_key(h, p);
+	id_index_add(h, p);
+	name_index_add(h, p);
+	
+	if (h->backend == BACKEND_SWISS)
+	{
+		swiss_insert(h, p);
+		return;
+	}
+	
+	rehash_step(h);
+	
+	h->num_elements++;
+	
+	// We need to grab the hash table index using our hashing
+	// function. New people always go into the current array.
+	chain_insert(&h->store[p->hash % h->length], p);
 	
-	// Grab hash index
-	hash_index = hash_function(first_name, last_name);
+	check_load(h);
+}
 
-	// Case: Head is null 
-	if (h->store[hash_index] == NULL)
-		return 0;
+// Make room for n more people up front, so a bulk load doesn't resize over and over
+static void reserve(struct hashtable* h, int n)
+{
+	int length, capacity;
 	
-	// Case: Head of chain is the person we are looking for, normally we could just check
-	//       if the ID is the one we're looking for, but for the sake of debugging to make
-	//       sure our input file doesn't have duplicate ID's, let's check the first and last name.
-	if (strcmp(strcpy(temp_first, to_lowercase(h->store[hash_index]->first_name)), first_name) == 0 &&
-		strcmp(strcpy(temp_last, to_lowercase(h->store[hash_index]->last_name)), last_name) == 0 &&
-		pid == h->store[hash_index]->id)
+	id_index_reserve(h, n);
+	if (h->backend == BACKEND_SWISS)
 	{
-		temp = h->store[hash_index];
-		if (h->store[hash_index]->next == NULL)
-		
-			h->store[hash_index] = NULL;
-		else 
-		{ 	
-			h->store[hash_index] = h->store[hash_index]->next;
+		if (h->growth_left >= n)
+			return;
+		capacity = h->capacity;
+		while (h->num_elements + n > capacity - capacity / 8)
+			capacity *= 2;
+		// Same capacity still helps, it clears out the DELETED slots
+		swiss_rehash(h, capacity);
+		return;
+	}
+	
+	length = h->length;
+	while (h->num_elements + n > length * MAX_LOAD)
+		length = length * 2 + 1;
+	if (length != h->length)
+	{
+		resize(h, length);
+		finish_rehash(h);
+	}
+}
+
+// Insert into a table that reserve already made room in, skipping the load checks
+static void bulk_insert(struct hashtable* h, struct person* p)
+{
+	cache_key(h, p);
+	id_index_add(h, p);
+	name_index_add(h, p);
+	if (h->backend == BACKEND_SWISS)
+		swiss_insert(h, p);
+	else
+	{
+		h->num_elements++;
+		chain_insert(&h->store[p->hash % h->length], p);
+	}
+}
+
+static int is_space(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+// Find the first whitespace character at or after p, or end if there is none.
+// Checks 16 characters at a time with SSE2, falling back to one at a time.
+static char* find_space(char* p, char* end)
+{
+#if defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i tab = _mm_set1_epi8('\t');
+	__m128i x;
+	int mask;
+	
+	while (end - p >= 16)
+	{
+		x = _mm_loadu_si128((const __m128i*)p);
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, space), _mm_cmpeq_epi8(x, newline)),
+											  _mm_or_si128(_mm_cmpeq_epi8(x, cr), _mm_cmpeq_epi8(x, tab))));
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#endif
+	while (p < end && !is_space(*p))
+		p++;
+	return p;
+}
+
+// Cut the next word out of the text in place. The whitespace after it is
+// overwritten with '\0' so the word can be used as a string right where it
+// is. Returns NULL if there are no more words, or if the last word runs
+// into the end of the text with nowhere to put the '\0'.
+static char* next_word(char** pos, char* end)
+{
+	char* word;
+	char* word_end;
+	
+	while (*pos < end && is_space(**pos))
+		(*pos)++;
+	if (*pos == end)
+		return NULL;
+	
+	word = *pos;
+	word_end = find_space(word, end);
+	if (word_end == end)
+		return NULL;
+	
+	*word_end = '\0';
+	if (word_end - word >= MAX_LEN)
+		word[MAX_LEN - 1] = '\0';
+	*pos = word_end + 1;
+	return word;
+}
+
+// Parse the next word as a number, returns 0 if there isn't one
+static int next_int(char** pos, char* end, int* value)
+{
+	int negative = 0, digits = 0;
+	
+	while (*pos < end && is_space(**pos))
+		(*pos)++;
+	if (*pos < end && **pos == '-')
+	{
+		negative = 1;
+		(*pos)++;
+	}
+	
+	*value = 0;
+	while (*pos < end && **pos >= '0' && **pos <= '9')
+	{
+		*value = *value * 10 + (**pos - '0');
+		(*pos)++;
+		digits++;
+	}
+	if (negative)
+		*value = -*value;
+	return digits > 0;
+}
+
+// Map a whole file into memory, or read it into a buffer if it can't be mapped
+static struct people_file* open_people_file(const char* filename)
+{
+	struct people_file* f;
+	struct stat st;
+	ssize_t got;
+	size_t done;
+	int fd;
+	
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	
+	f = malloc(sizeof(struct people_file));
+	f->size = st.st_size;
+	f->mapped = 0;
+	f->text = NULL;
+	
+	// The mapping is private, so writing the '\0's doesn't touch the file
+	if (f->size > 0)
+	{
+		f->text = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (f->text == MAP_FAILED)
+			f->text = NULL;
+		else
+		{
+			f->mapped = 1;
+			madvise(f->text, f->size, MADV_SEQUENTIAL);
 		}
-		
-		free(temp);
-			
-		return 1;
 	}
 	
-	// Set current node to point at beginning of potential chain at hash index
-	current_node = h->store[hash_index];
+	// Case: Empty file or mmap failed (e.g. a pipe), read it the slow way.
+	//       One extra byte so the last word can always be cut off.
+	if (f->text == NULL)
+	{
+		f->text = malloc(f->size + 1);
+		done = 0;
+		while (done < f->size && (got = read(fd, f->text + done, f->size - done)) > 0)
+			done += got;
+		f->size = done;
+		f->text[f->size] = '\n';
+	}
+	
+	close(fd);
+	return f;
+}
+
+// Load everyone in a people file into the table. The people's names point
+// into the returned file, so close it only after the table is deleted.
+// The number of people loaded goes in *count. Returns NULL if the file
+// couldn't be opened.
+struct people_file* load_people(struct hashtable* h, const char* filename, int* count)
+{
+	struct people_file* f;
+	struct person* p;
+	char* pos;
+	char* end;
+	char* first_name;
+	char* last_name;
+	int num_entries, id;
+	
+	f = open_people_file(filename);
+	if (f == NULL)
+		return NULL;
+	
+	pos = f->text;
+	// A buffer we read into has room for one more character past the end
+	end = f->text + f->size + !f->mapped;
+	*count = 0;
 	
-	// Because the node is sorted lexicographically by the first name, we can stop if
-	// the first name of our current node comes before (lexicographically) than the name we're
-	// looking for.
-	while (current_node->next != NULL &&
-		   strcmp(strcpy(temp_first, to_lowercase(current_node->next->first_name)), first_name) < 0)
+	// How many people are we scanning in?
+	if (!next_int(&pos, end, &num_entries) || num_entries < 0)
+		return f;
+	reserve(h, num_entries);
+	
+	while (*count < num_entries &&
+		   (first_name = next_word(&pos, end)) != NULL &&
+		   (last_name = next_word(&pos, end)) != NULL &&
+		   next_int(&pos, end, &id))
 	{
-		current_node = current_node->next;
+		p = new_person(h);
+		p->first_name = first_name;
+		p->last_name = last_name;
+		p->id = id;
+		p->next = NULL;
+		bulk_insert(h, p);
+		(*count)++;
 	}
 	
-	// Case: Either the next node is NULL OR the current node COULD be the person
-	//       we are looking for. At this point we really only need to check the id 
-	//       because that's what we're basing our deletes off of.
-	if (current_node->next == NULL || current_node->next->id != pid)
-		return 0;
-		
-	// Case: We've found the matching person!
-	temp = current_node->next;
-	current_node->next = current_node->next->next;
-	free(temp);
-	return 1;	
+	return f;
 }
 
+// People one thread parsed that go into one part of the table
+struct slot_list {
+	struct slot* slots;
+	int count;
+	int capacity;
+};
 
-// Free all memory allocated to hash table and it's elements
-void delete_hashtable(struct hashtable* h) 
+// What each thread of load_people_parallel works on
+struct ingest_worker {
+	pthread_t thread;
+	struct hashtable* h;
+	struct ingest_worker* workers; // Everybody, so the merge can find each part
+	int index;
+	int num_workers;
+	// Counting: the range of text, how many words start in it and where the first one is
+	char* range_start;
+	char* range_end;
+	char* first_word;
+	long num_words;
+	// Parsing: records from start up to stop, numbered from first_record
+	char* start;
+	char* stop;
+	long first_record;
+	long num_entries;
+	struct slab* pool;
+	struct slot_list* parts; // One per worker, by which worker's part of the table they hash to
+	int num_parsed;
+	// Merging
+	struct slot_list overflow; // Swiss people whose probe left this worker's part
+	int num_placed;
+	int empty_used;
+};
+
+static void slot_list_add(struct slot_list* list, uint64_t hash, struct person* p)
 {
-	int i;
-	struct person* temp;
-	struct person* current_node;
+	if (list->count == list->capacity)
+	{
+		list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+		list->slots = realloc(list->slots, list->capacity * sizeof(struct slot));
+	}
+	list->slots[list->count].hash = hash;
+	list->slots[list->count].p = p;
+	list->count++;
+}
+
+// Which worker's part of the table a hash lands in. Chained tables are
+// split by bucket, swiss tables by the home group of the probe.
+static int ingest_part(struct hashtable* h, uint64_t hash, int num_parts)
+{
+	int num_groups;
 	
-	for (i = 0; i < h->length; i++)
+	if (h->backend == BACKEND_SWISS)
 	{
-		current_node = h->store[i];	
-		while (current_node != NULL) 
+		num_groups = h->capacity / GROUP_WIDTH;
+		return (int)((int64_t)((hash >> 7) & (num_groups - 1)) * num_parts / num_groups);
+	}
+	return (int)((int64_t)(hash % h->length) * num_parts / h->length);
+}
+
+// Count the words starting in the worker's range and remember the first
+static void* ingest_count(void* arg)
+{
+	struct ingest_worker* w = arg;
+	char* p;
+	int in_word;
+	
+	w->first_word = NULL;
+	w->num_words = 0;
+	in_word = w->range_start > w->workers[0].range_start && !is_space(w->range_start[-1]);
+	for (p = w->range_start; p < w->range_end; p++)
+	{
+		if (is_space(*p))
+			in_word = 0;
+		else if (!in_word)
 		{
-			// Free the people!
-			temp = current_node;
-			current_node = current_node->next;
-			free(temp);
+			in_word = 1;
+			if (w->num_words++ == 0)
+				w->first_word = p;
 		}
 	}
+	return NULL;
+}
+
+// Parse the worker's records into people and sort them by part. Each
+// worker only reads and writes text up to where the next one starts.
+static void* ingest_parse(void* arg)
+{
+	struct ingest_worker* w = arg;
+	struct person* p;
+	char* pos = w->start;
+	char* first_name;
+	char* last_name;
+	uint64_t hash;
+	int id;
+	
+	w->parts = calloc(w->num_workers, sizeof(struct slot_list));
+	w->num_parsed = 0;
+	if (pos == NULL)
+		return NULL;
+	
+	while (w->first_record + w->num_parsed < w->num_entries &&
+		   (first_name = next_word(&pos, w->stop)) != NULL &&
+		   (last_name = next_word(&pos, w->stop)) != NULL &&
+		   next_int(&pos, w->stop, &id))
+	{
+		p = w->pool != NULL ? slab_alloc(w->pool) : malloc(sizeof(struct person));
+		p->first_name = first_name;
+		p->last_name = last_name;
+		p->id = id;
+		p->next = NULL;
+		cache_key(w->h, p);
+		
+		hash = p->hash;
+		slot_list_add(&w->parts[ingest_part(w->h, hash, w->num_workers)], hash, p);
+		w->num_parsed++;
+	}
+	return NULL;
+}
+
+// Link everyone every worker parsed for this worker's part into the table.
+// Parts don't share buckets (or groups), so nobody needs a lock.
+static void* ingest_merge(void* arg)
+{
+	struct ingest_worker* w = arg;
+	struct hashtable* h = w->h;
+	struct slot_list* list;
+	struct slot* item;
+	int i, j, slot;
 	
-	// Free the array of people
-	free(h->store);
-	// Free the hash table
-	free(h);
- } 
- 
- void print_table(struct hashtable* h)
- {
+	w->num_placed = 0;
+	w->empty_used = 0;
+	memset(&w->overflow, 0, sizeof(w->overflow));
+	for (i = 0; i < w->num_workers; i++)
+	{
+		list = &w->workers[i].parts[w->index];
+		for (j = 0; j < list->count; j++)
+		{
+			item = &list->slots[j];
+			if (h->backend == BACKEND_CHAINED)
+			{
+				chain_insert(&h->store[item->hash % h->length], item->p);
+				w->num_placed++;
+				continue;
+			}
+			
+			slot = swiss_find_free_in(h, item->hash, w->index, w->num_workers);
+			if (slot < 0)
+			{
+				slot_list_add(&w->overflow, item->hash, item->p);
+				continue;
+			}
+			if (h->ctrl[slot] == CTRL_EMPTY)
+				w->empty_used++;
+			h->ctrl[slot] = (signed char)(item->hash & 0x7f);
+			h->slots[slot] = *item;
+			w->num_placed++;
+		}
+	}
+	return NULL;
+}
+
+static void run_workers(struct ingest_worker* workers, int num_workers, void* (*fn)(void*))
+{
 	int i;
-	struct person* current_node;
+	
+	for (i = 0; i < num_workers; i++)
+		pthread_create(&workers[i].thread, NULL, fn, &workers[i]);
+	for (i = 0; i < num_workers; i++)
+		pthread_join(workers[i].thread, NULL);
+}
+
+// Same as load_people, but the file is parsed and linked into the table on
+// num_threads threads. Works in three rounds:
+//   1. Each thread counts the words starting in its share of the text, which
+//      tells every thread how many words (and so records) come before it.
+//   2. Each thread parses the records starting in its share into people and
+//      sorts them by which thread owns the part of the table they hash to.
+//   3. Each thread links in the people for its own part of the table.
+// Swiss people whose probe would leave their part (rare, the table is kept
+// at most 7/8 full) are placed afterwards on this thread.
+struct people_file* load_people_parallel(struct hashtable* h, const char* filename, int num_threads, int* count)
+{
+	struct people_file* f;
+	struct ingest_worker* workers;
+	struct ingest_worker* w;
+	char* pos;
+	char* end;
+	long words_before, skip;
+	int i, j, k, num_entries;
+	
+	f = open_people_file(filename);
+	if (f == NULL)
+		return NULL;
+	
+	pos = f->text;
+	end = f->text + f->size + !f->mapped;
+	*count = 0;
+	if (!next_int(&pos, end, &num_entries) || num_entries < 0)
+		return f;
+	
+	thaw(h);
+	finish_rehash(h);
+	reserve(h, num_entries);
+	
+	if (num_threads < 1)
+		num_threads = 1;
+	workers = calloc(num_threads, sizeof(struct ingest_worker));
+	for (i = 0; i < num_threads; i++)
+	{
+		w = &workers[i];
+		w->h = h;
+		w->workers = workers;
+		w->index = i;
+		w->num_workers = num_threads;
+		w->range_start = pos + (end - pos) * i / num_threads;
+		w->range_end = pos + (end - pos) * (i + 1) / num_threads;
+		w->num_entries = num_entries;
+		w->pool = h->pool != NULL ? slab_create(sizeof(struct person)) : NULL;
+	}
+	
+	run_workers(workers, num_threads, ingest_count);
+	
+	// Records are three words, so move each thread's start up to the first
+	// record that starts in its share. Done here since a word a thread
+	// skips may be getting cut off by the thread before it.
+	words_before = 0;
+	for (i = 0; i < num_threads; i++)
+	{
+		w = &workers[i];
+		w->start = w->first_word;
+		skip = (3 - words_before % 3) % 3;
+		w->first_record = (words_before + skip) / 3;
+		if (skip >= w->num_words)
+			w->start = NULL;
+		for (j = 0; j < skip && w->start != NULL; j++)
+		{
+			w->start = find_space(w->start, w->range_end);
+			while (is_space(*w->start))
+				w->start++;
+		}
+		words_before += w->num_words;
+	}
+	for (i = 0; i < num_threads; i++)
+	{
+		workers[i].stop = end;
+		for (j = i + 1; j < num_threads; j++)
+		{
+			if (workers[j].start != NULL)
+			{
+				workers[i].stop = workers[j].start;
+				break;
+			}
+		}
+	}
+	
+	run_workers(workers, num_threads, ingest_parse);
+	run_workers(workers, num_threads, ingest_merge);
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		w = &workers[i];
+		h->num_elements += w->num_placed;
+		h->growth_left -= w->empty_used;
+		*count += w->num_parsed;
+	}
+	for (i = 0; i < num_threads; i++)
+	{
+		w = &workers[i];
+		for (j = 0; j < w->overflow.count; j++)
+			swiss_insert_hashed(h, w->overflow.slots[j].p, w->overflow.slots[j].hash);
+		free(w->overflow.slots);
+		// The ID index isn't split up by part, so it's filled in here on one
+		// thread. That's only a pointer store per person, reserve made the room.
+		// The name indexes only need filling in if a search already built them.
+		for (j = 0; j < num_threads; j++)
+		{
+			for (k = 0; k < w->parts[j].count; k++)
+			{
+				id_index_add(h, w->parts[j].slots[k].p);
+				name_index_add(h, w->parts[j].slots[k].p);
+			}
+			free(w->parts[j].slots);
+		}
+		free(w->parts);
+		if (w->pool != NULL)
+			slab_merge(h->pool, w->pool);
+	}
+	
+	free(workers);
+	return f;
+}
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Let go of a people file, only once nobody points into it anymore
+void close_people_file(struct people_file* f)
+{
+	if (f->mapped)
+		munmap(f->text, f->size);
+	else
+		free(f->text);
+	free(f);
+}
+
+// The hash functions a snapshot can name, its hash_id indexes this
+static const hash_fn snapshot_hashes[] = { hash_wy, hash_sip, hash_ascii_sum };
+
+static uint32_t* snapshot_buckets(struct snapshot_header* s)
+{
+	return (uint32_t*)(s + 1);
+}
+
+static struct snapshot_record* snapshot_records(struct snapshot_header* s)
+{
+	return (struct snapshot_record*)(snapshot_buckets(s) + s->num_buckets);
+}
+
+static char* snapshot_pool(struct snapshot_header* s)
+{
+	return (char*)(snapshot_records(s) + s->num_records);
+}
+
+// Checksum size bytes a word at a time, continuing from sum
+static uint64_t checksum(uint64_t sum, const void* data, size_t size)
+{
+	const unsigned char* p = data;
+	uint64_t word;
+	
+	for (; size >= 8; p += 8, size -= 8)
+	{
+		memcpy(&word, p, 8);
+		sum = (sum ^ word) * 0x100000001b3ULL;
+		sum ^= sum >> 29;
+	}
+	for (; size > 0; p++, size--)
+		sum = (sum ^ *p) * 0x100000001b3ULL;
+	return sum;
+}
+
+// Turn a snapshot the table is frozen on into ordinary people, so it can change.
+// The names stay where they are in the snapshot's pool.
+static void thaw(struct hashtable* h)
+{
+	struct snapshot_header* s = h->frozen;
+	struct snapshot_record* records;
+	struct person* p;
+	char* pool;
+	uint32_t i;
+	
+	if (s == NULL)
+		return;
+	h->frozen = NULL;
+	
+	records = snapshot_records(s);
+	pool = snapshot_pool(s);
+	reserve(h, s->num_records);
+	for (i = 0; i < s->num_records; i++)
+	{
+		p = new_person(h);
+		p->first_name = pool + records[i].first_name;
+		p->last_name = pool + records[i].last_name;
+		p->id = records[i].id;
+		p->next = NULL;
+		bulk_insert(h, p);
+	}
+}
+
+// Prints all people in a frozen table's snapshot matching the name
+static int snapshot_lookup(struct hashtable* h, char first_name[], char last_name[])
+{
+	struct snapshot_header* s = h->frozen;
+	struct snapshot_record* records = snapshot_records(s);
+	char* pool = snapshot_pool(s);
+	uint32_t i;
+	int seen = 0;
+	
+	printf("\n");
+	i = snapshot_buckets(s)[hash_function(h, first_name, last_name) % s->num_buckets];
+	for (; i != SNAPSHOT_NONE; i = records[i].next)
+	{
+		if (same_name(pool + records[i].first_name, first_name) &&
+			same_name(pool + records[i].last_name, last_name))
+		{
+			seen = 1;
+			printf("Found name: %s %s  ", pool + records[i].first_name, pool + records[i].last_name);
+			printf("Personal ID: %d\n", records[i].id);
+		}
+	}
+	
+	if (seen == 0)
+	{
+		printf("I'm sorry, I could not find %s %s in the database\n\n", first_name, last_name);
+		return 0;
+	}
+	printf("\n");
+	return 1;
+}
+
+// Write everyone in the table to a snapshot file. The file is written under a
+// temporary name and renamed over filename, so a snapshot that is currently
+// mapped (or a crash halfway through) never leaves a half written file behind.
+// Returns 1 on success, 0 if the file couldn't be written.
+int save_snapshot(struct hashtable* h, const char* filename)
+{
+	struct snapshot_header header;
+	struct snapshot_record* records;
+	struct person** people;
+	uint32_t* buckets;
+	uint32_t* bucket_of;
+	uint32_t* starts;
+	char* pool;
+	char temp_name[FILENAME_MAX];
+	size_t first_len, last_len;
+	uint32_t i, b, n, num_buckets, r;
+	uint64_t pool_size;
+	FILE* fp;
+	int ok;
+	
+	thaw(h);
+	
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.version = SNAPSHOT_VERSION;
+	for (header.hash_id = 0; header.hash_id < 3 && snapshot_hashes[header.hash_id] != h->hash; header.hash_id++)
+		;
+	// Case: A hash function we have no id for, the snapshot couldn't be reloaded
+	if (header.hash_id == 3)
+		return 0;
+	header.seed = h->seed;
+	
+	n = h->num_elements;
+	people = malloc((n + 1) * sizeof(struct person*));
+	gather_people(h, people);
+	
+	// Keep the chained backend's buckets as they are, otherwise
+	// aim for about one person per bucket
+	num_buckets = h->backend == BACKEND_CHAINED ? (uint32_t)h->length : (n > INITIAL_LEN ? n : INITIAL_LEN);
+	
+	// Sort everyone by bucket (counting sort, which keeps chain order) so
+	// each chain's records end up next to each other in the file
+	bucket_of = malloc((n + 1) * sizeof(uint32_t));
+	starts = calloc(num_buckets + 1, sizeof(uint32_t));
+	pool_size = 0;
+	for (i = 0; i < n; i++)
+	{
+		bucket_of[i] = people[i]->hash % num_buckets;
+		starts[bucket_of[i] + 1]++;
+		pool_size += strlen(people[i]->first_name) + strlen(people[i]->last_name) + 2;
+	}
+	// Offsets are 32 bits
+	if (pool_size > SNAPSHOT_NONE)
+	{
+		free(people);
+		free(bucket_of);
+		free(starts);
+		return 0;
+	}
+	
+	buckets = malloc(num_buckets * sizeof(uint32_t));
+	for (b = 0; b < num_buckets; b++)
+	{
+		starts[b + 1] += starts[b];
+		buckets[b] = starts[b] == starts[b + 1] ? SNAPSHOT_NONE : starts[b];
+	}
+	
+	records = malloc((n + 1) * sizeof(struct snapshot_record));
+	for (i = 0; i < n; i++)
+	{
+		r = starts[bucket_of[i]]++;
+		records[r].id = people[i]->id;
+		// Borrow first_name to remember who goes here until the pool is built
+		records[r].first_name = i;
+		records[r].next = starts[bucket_of[i]] == starts[bucket_of[i] + 1] ? SNAPSHOT_NONE : r + 1;
+	}
+	
+	// Lay out the names in record order, so a chain's names are close together too
+	pool = malloc(pool_size + 1);
+	pool_size = 0;
+	for (r = 0; r < n; r++)
+	{
+		i = records[r].first_name;
+		first_len = strlen(people[i]->first_name) + 1;
+		last_len = strlen(people[i]->last_name) + 1;
+		records[r].first_name = pool_size;
+		memcpy(pool + pool_size, people[i]->first_name, first_len);
+		pool_size += first_len;
+		records[r].last_name = pool_size;
+		memcpy(pool + pool_size, people[i]->last_name, last_len);
+		pool_size += last_len;
+	}
+	
+	header.num_buckets = num_buckets;
+	header.num_records = n;
+	header.pool_size = pool_size;
+	header.checksum = checksum(0xcbf29ce484222325ULL, &header, sizeof(header));
+	header.checksum = checksum(header.checksum, buckets, num_buckets * sizeof(uint32_t));
+	header.checksum = checksum(header.checksum, records, n * sizeof(struct snapshot_record));
+	header.checksum = checksum(header.checksum, pool, pool_size);
+	
+	snprintf(temp_name, sizeof(temp_name), "%s.tmp", filename);
+	fp = fopen(temp_name, "wb");
+	ok = fp != NULL;
+	if (ok)
+	{
+		ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+			 fwrite(buckets, sizeof(uint32_t), num_buckets, fp) == num_buckets &&
+			 fwrite(records, sizeof(struct snapshot_record), n, fp) == n &&
+			 fwrite(pool, 1, pool_size, fp) == pool_size;
+		ok = fclose(fp) == 0 && ok;
+		ok = ok && rename(temp_name, filename) == 0;
+		if (!ok)
+			remove(temp_name);
+	}
+	
+	free(people);
+	free(bucket_of);
+	free(starts);
+	free(buckets);
+	free(records);
+	free(pool);
+	return ok;
+}
+
+// Map a snapshot in and freeze the (empty) table on it. Nothing is done per
+// person: lookups walk the snapshot in place until the table first changes.
+// Like load_people the people's names point into the returned file, so close
+// it only after the table is deleted. Returns NULL if the file can't be opened,
+// isn't a snapshot of this version, is damaged, or the table isn't empty.
+struct people_file* load_snapshot(struct hashtable* h, const char* filename, int* count)
+{
+	struct people_file* f;
+	struct snapshot_header* s;
+	uint64_t sum, stored, expected_size;
+	
+	if (h->num_elements != 0 || h->frozen != NULL)
+		return NULL;
+	f = open_people_file(filename);
+	if (f == NULL)
+		return NULL;
+	
+	s = (struct snapshot_header*)f->text;
+	if (f->size < sizeof(struct snapshot_header) ||
+		memcmp(s->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+		s->version != SNAPSHOT_VERSION ||
+		s->hash_id >= 3 ||
+		s->num_buckets == 0)
+	{
+		close_people_file(f);
+		return NULL;
+	}
+	
+	// The sections have to add up to exactly the file
+	expected_size = sizeof(struct snapshot_header) + (uint64_t)s->num_buckets * sizeof(uint32_t) +
+					(uint64_t)s->num_records * sizeof(struct snapshot_record) + s->pool_size;
+	if (expected_size != f->size)
+	{
+		close_people_file(f);
+		return NULL;
+	}
+	
+	// Sum the header with its checksum zeroed, then each section the
+	// same way save_snapshot did
+	stored = s->checksum;
+	s->checksum = 0;
+	sum = checksum(0xcbf29ce484222325ULL, s, sizeof(struct snapshot_header));
+	s->checksum = stored;
+	sum = checksum(sum, snapshot_buckets(s), s->num_buckets * sizeof(uint32_t));
+	sum = checksum(sum, snapshot_records(s), s->num_records * sizeof(struct snapshot_record));
+	sum = checksum(sum, snapshot_pool(s), s->pool_size);
+	if (sum != stored)
+	{
+		close_people_file(f);
+		return NULL;
+	}
+	
+	set_hash(h, snapshot_hashes[s->hash_id], s->seed);
+	h->frozen = s;
+	*count = s->num_records;
+	return f;
+}
+
+// Hash a person's name with the table's hash function and seed.
+// The caller mods the result by the length of the table.
+uint64_t hash_function(struct hashtable* h, char first_name[], char last_name[]) 
+{
+	return h->hash(first_name, last_name, h->seed);
+}
+
+// Pick the hash function and seed for a table. Only allowed while the table
+// is empty since everyone already stored was placed with the old function.
+int set_hash(struct hashtable* h, hash_fn hash, uint64_t seed)
+{
+	if (h->num_elements != 0)
+		return 0;
+	
+	h->hash = hash;
+	h->seed = seed;
+	return 1;
+}
+
+// Grab a random seed so bucket placement can't be predicted from outside
+uint64_t random_seed(void)
+{
+	uint64_t seed = 0;
+	FILE* fp;
+	
+	fp = fopen("/dev/urandom", "rb");
+	if (fp != NULL)
+	{
+		if (fread(&seed, sizeof(seed), 1, fp) != 1)
+			seed = 0;
+		fclose(fp);
+	}
+	
+	// No urandom (or it failed), fall back to the clock and an address
+	if (seed == 0)
+		seed = (uint64_t)time(NULL) ^ ((uint64_t)(uintptr_t)&seed << 16);
+	
+	return seed;
+}
+
+// Load up to 8 bytes of s as a little endian word and lowercase every
+// ASCII letter in it at once. This folds case a word at a time instead
+// of copying the name and calling tolower on each char.
+static uint64_t load_folded(const char* s, size_t n)
+{
+	const uint64_t ones = 0x0101010101010101ULL;
+	uint64_t x = 0, heptets, is_gt_z, is_ge_a, is_upper;
+	
+	memcpy(&x, s, n);
+	
+	// Each byte gets its high bit set if it is in 'A'..'Z', then that
+	// bit is shifted down onto the 0x20 bit that separates the cases.
+	heptets = x & (0x7f * ones);
+	is_gt_z = heptets + ((0x7f - 'Z') * ones);
+	is_ge_a = heptets + ((0x80 - 'A') * ones);
+	is_upper = (is_ge_a ^ is_gt_z) & ~x & (0x80 * ones);
+	
+	return x | (is_upper >> 2);
+}
+
+// 64x64 -> 128 bit multiply folded back down to 64 bits
+static uint64_t mum(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t)a * b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+	uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+	uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+	uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+	uint64_t lo = (cross << 32) | (uint32_t)lo_lo;
+	uint64_t hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+	return lo ^ hi;
+#endif
+}
+
+// Constants borrowed from wyhash
+#define WY_P0 0xa0761d6478bd642fULL
+#define WY_P1 0xe7037ed1a0b428dbULL
+#define WY_P2 0x8ebc6af09c88c6e3ULL
+#define WY_P3 0x589965cc75374cc3ULL
+
+// wyhash style mixing of one name, 16 bytes per round
+static uint64_t wy_name(const char* s, uint64_t seed)
+{
+	size_t n = strlen(s);
+	uint64_t a, b, len = n;
+	
+	while (n > 16)
+	{
+		seed = mum(load_folded(s, 8) ^ WY_P1, load_folded(s + 8, 8) ^ seed);
+		s += 16;
+		n -= 16;
+	}
+	
+	a = load_folded(s, n < 8 ? n : 8);
+	b = n > 8 ? load_folded(s + 8, n - 8) : 0;
+	
+	return mum(a ^ WY_P1 ^ len, b ^ seed);
+}
+
+// Fast default hash. Both names are mixed in order, so "ann lee" and "lee ann"
+// (or any other anagram) land in different places.
+uint64_t hash_wy(const char* first_name, const char* last_name, uint64_t seed)
+{
+	uint64_t hash;
+	
+	hash = wy_name(first_name, seed ^ WY_P0);
+	hash = wy_name(last_name, hash ^ WY_P2);
+	
+	return mum(hash ^ WY_P3, hash ^ WY_P1);
+}
+
+#define ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+static void sip_round(uint64_t v[4])
+{
+	v[0] += v[1]; v[1] = ROTL(v[1], 13); v[1] ^= v[0]; v[0] = ROTL(v[0], 32);
+	v[2] += v[3]; v[3] = ROTL(v[3], 16); v[3] ^= v[2];
+	v[0] += v[3]; v[3] = ROTL(v[3], 21); v[3] ^= v[0];
+	v[2] += v[1]; v[1] = ROTL(v[1], 17); v[1] ^= v[2]; v[2] = ROTL(v[2], 32);
+}
+
+static void sip_block(uint64_t v[4], uint64_t m)
+{
+	v[3] ^= m;
+	sip_round(v);
+	v[0] ^= m;
+}
+
+// Feed one name into the SipHash state. Every name ends with its own block
+// tagged with the name's length, so the first/last split can't be shifted
+// around to forge a collision.
+static void sip_name(uint64_t v[4], const char* s)
+{
+	size_t n = strlen(s);
+	uint64_t len = n;
+	
+	while (n >= 8)
+	{
+		sip_block(v, load_folded(s, 8));
+		s += 8;
+		n -= 8;
+	}
+	sip_block(v, load_folded(s, n) | (len << 56));
+}
+
+// Seeded SipHash-1-3, for tables filled from input we don't trust.
+// Without the seed an attacker can't precompute names that all collide.
+uint64_t hash_sip(const char* first_name, const char* last_name, uint64_t seed)
+{
+	uint64_t k0, k1, v[4];
+	
+	// Stretch the 64 bit seed into SipHash's two key words
+	k0 = seed;
+	k1 = mum(seed ^ WY_P0, WY_P1);
+	
+	v[0] = k0 ^ 0x736f6d6570736575ULL;
+	v[1] = k1 ^ 0x646f72616e646f6dULL;
+	v[2] = k0 ^ 0x6c7967656e657261ULL;
+	v[3] = k1 ^ 0x7465646279746573ULL;
+	
+	sip_name(v, first_name);
+	sip_name(v, last_name);
+	
+	v[2] ^= 0xff;
+	sip_round(v);
+	sip_round(v);
+	sip_round(v);
+	
+	return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+// The original hash, summing the ASCII values of first + last names.
+// Kept around as a baseline for the distribution report.
+uint64_t hash_ascii_sum(const char* first_name, const char* last_name, uint64_t seed)
+{
+	uint64_t string_sum;
+	int j;
+	
+	(void)seed;
+	string_sum = 0;
+	for (j = 0; first_name[j] != '\0'; j++)
+		string_sum += tolower((unsigned char)first_name[j]) - '0';
+	for (j = 0; last_name[j] != '\0'; j++)
+		string_sum += tolower((unsigned char)last_name[j]) - '0';
+	
+	return string_sum;
+}
+
+struct hashed_person {
+	uint64_t hash;
+	struct person* p;
+};
+
+static int compare_hashed(const void* a, const void* b)
+{
+	uint64_t x = ((const struct hashed_person*)a)->hash;
+	uint64_t y = ((const struct hashed_person*)b)->hash;
+	return (x > y) - (x < y);
+}
+
+// Compare two names ignoring case without copying either of them,
+// < 0 if a comes first, 0 if they're the same and > 0 if b comes first
+static int compare_names(const char* a, const char* b)
+{
+	while (*a != '\0' && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+	{
+		a++;
+		b++;
+	}
+	return tolower((unsigned char)*a) - tolower((unsigned char)*b);
+}
+
+static int same_name(const char* a, const char* b)
+{
+	return compare_names(a, b) == 0;
+}
+
+// Work out the hash and lengths a person keeps for probes
+static void cache_key(struct hashtable* h, struct person* p)
+{
+	p->hash = hash_function(h, p->first_name, p->last_name);
+	p->first_length = strlen(p->first_name);
+	p->last_length = strlen(p->last_name);
+}
+
+static void make_key(struct hashtable* h, const char* first_name, const char* last_name, struct name_key* key)
+{
+	key->first_name = first_name;
+	key->last_name = last_name;
+	key->hash = h->hash(first_name, last_name, h->seed);
+	key->first_length = strlen(first_name);
+	key->last_length = strlen(last_name);
+}
+
+// Does the person have the name? The characters only get
+// looked at once the hash and both lengths already match.
+static int has_key(struct person* p, struct name_key* key)
+{
+	return p->hash == key->hash &&
+		   p->first_length == key->first_length &&
+		   p->last_length == key->last_length &&
+		   same_name(p->first_name, key->first_name) &&
+		   same_name(p->last_name, key->last_name);
+}
+
+// Fill people with everyone in the table, whichever backend it uses
+static int gather_people(struct hashtable* h, struct person** people)
+{
+	struct person* current_node;
+	int i, n = 0;
+	
+	finish_rehash(h);
+	
+	for (i = 0; i < h->length; i++)
+		for (current_node = h->store[i]; current_node != NULL; current_node = current_node->next)
+			people[n++] = current_node;
+	for (i = 0; i < h->capacity; i++)
+		if (h->ctrl[i] >= 0)
+			people[n++] = h->slots[i].p;
+	
+	return n;
+}
+
+// Print how evenly each of our hash functions spreads the people currently in
+// the table over its buckets (or home slots), along with full 64 bit collisions between people
+// whose names actually differ (anagrams included).
+void hash_report(struct hashtable* h)
+{
+	const char* names[] = { "ascii sum", "wyhash", "siphash" };
+	hash_fn hashes[] = { hash_ascii_sum, hash_wy, hash_sip };
+	struct hashed_person* hashed;
+	struct person** people;
+	int* counts;
+	int i, j, n, buckets, used, longest, collisions;
+	double expected_empty;
+	
+	thaw(h);
+	n = h->num_elements;
+	if (n == 0)
+	{
+		printf("The table is empty, there is nothing to report!\n\n");
+		return;
+	}
+	
+	buckets = h->backend == BACKEND_SWISS ? h->capacity : h->length;
+	people = malloc(n * sizeof(struct person*));
+	hashed = malloc(n * sizeof(struct hashed_person));
+	counts = malloc(buckets * sizeof(int));
+	gather_people(h, people);
+	
+	// A truly random hash leaves buckets * (1 - 1/buckets)^n buckets empty
+	expected_empty = buckets;
+	for (i = 0; i < n; i++)
+		expected_empty *= 1.0 - 1.0 / buckets;
+	
+	printf("\n%d people in %d buckets (a random hash would use about %.0f)\n",
+		   n, buckets, buckets - expected_empty);
+	
+	for (j = 0; j < 3; j++)
+	{
+		memset(counts, 0, buckets * sizeof(int));
+		for (i = 0; i < n; i++)
+		{
+			hashed[i].hash = hashes[j](people[i]->first_name, people[i]->last_name, h->seed);
+			hashed[i].p = people[i];
+			counts[hashed[i].hash % buckets]++;
+		}
+		
+		used = 0;
+		longest = 0;
+		for (i = 0; i < buckets; i++)
+		{
+			if (counts[i] > 0)
+				used++;
+			if (counts[i] > longest)
+				longest = counts[i];
+		}
+		
+		// Sort by hash so equal hashes end up next to each other
+		qsort(hashed, n, sizeof(struct hashed_person), compare_hashed);
+		collisions = 0;
+		for (i = 1; i < n; i++)
+		{
+			if (hashed[i].hash == hashed[i - 1].hash &&
+				!(same_name(hashed[i].p->first_name, hashed[i - 1].p->first_name) &&
+				  same_name(hashed[i].p->last_name, hashed[i - 1].p->last_name)))
+				collisions++;
+		}
+		
+		printf("%c %-10s buckets used: %6d  longest chain: %6d  full hash collisions: %d\n",
+			   hashes[j] == h->hash ? '*' : ' ', names[j], used, longest, collisions);
+	}
+	printf("\n");
+	
+	free(people);
+	free(hashed);
+	free(counts);
+}
+
+// Prints all people in the database matching the first and last name (ignoring case).
+// Only reads the table, an ongoing resize is left to inserts and removes.
+int lookup(struct hashtable* h, char first_name[], char last_name[])
+{
+	int i, num_chains;
+	int seen;
+	struct person** chains[2];
+	struct person* current_node;
+	struct name_key key;
+	
+	if (h->frozen != NULL)
+		return snapshot_lookup(h, first_name, last_name);
+	if (h->backend == BACKEND_SWISS)
+		return swiss_lookup(h, first_name, last_name);
+	
+	// Grab the chains the name could hash to
+	make_key(h, first_name, last_name, &key);
+	num_chains = find_chains(h, key.hash, chains);
+
+	seen = 0;
+	printf("\n");
+	for (i = 0; i < num_chains; i++)
+	{
+		current_node = *chains[i];
+		while (current_node != NULL) 
+		{	
+			if (has_key(current_node, &key))
+			{
+				seen = 1;
+				printf("Found name: %s %s  ", current_node->first_name, current_node->last_name);
+				printf("Personal ID: %d\n", current_node->id);
+			}
+			current_node = current_node->next;
+		}
+	}
+	
+	if (seen == 0)
+	{
+		printf("I'm sorry, I could not find %s %s in the database\n\n", first_name, last_name);
+		return 0;
+	}
+	printf("\n");
+	return 1;
+}
+
+// Remove the person with a matching name and ID from a single chain
+static int chain_remove(struct hashtable* h, struct person** head, struct name_key* key, int pid)
+{
+	struct person** link;
+	struct person* temp;
+	
+	// Several people can share a name (or just a first name), so keep going
+	// until we find the one with the right ID. Normally we could just check
+	// the ID, but for the sake of debugging to make sure our input file
+	// doesn't have duplicate ID's, let's check the first and last name too.
+	for (link = head; *link != NULL; link = &(*link)->next)
+	{
+		if ((*link)->id == pid && has_key(*link, key))
+		{
+			temp = *link;
+			*link = temp->next;
+			id_index_remove(h, temp);
+			name_index_remove(h, temp);
+			release_person(h, temp);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Remove the person with the name and ID from whichever backend the table uses
+static int remove_key(struct hashtable* h, struct name_key* key, int pid)
+{
+	int i, num_chains;
+	struct person** chains[2];
+	
+	if (h->backend == BACKEND_SWISS)
+		return swiss_remove(h, key, pid);
+	
+	rehash_step(h);
+	
+	// Grab the chains the name could hash to
+	num_chains = find_chains(h, key->hash, chains);
+	
+	for (i = 0; i < num_chains; i++)
+	{
+		if (chain_remove(h, chains[i], key, pid))
+		{
+			h->num_elements--;
+			check_load(h);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int remove_person(struct hashtable* h, char first_name[], char last_name[], int pid)
+{
+	// if successfully removed return 1
+	struct name_key key;
+	
+	thaw(h);
+	make_key(h, first_name, last_name, &key);
+	return remove_key(h, &key, pid);
+}
+
+// Prints everyone with the ID (there should only be one)
+int lookup_by_id(struct hashtable* h, int pid)
+{
+	struct person* p;
+	int slot, seen;
+	
+	// A snapshot has no ID index, so the first lookup by ID thaws it
+	thaw(h);
+	
+	seen = 0;
+	printf("\n");
+	for (slot = id_home(h, pid); h->by_id[slot] != NULL; slot = (slot + 1) & (h->id_capacity - 1))
+	{
+		p = h->by_id[slot];
+		if (p->id != pid)
+			continue;
+		seen = 1;
+		printf("Found name: %s %s  ", p->first_name, p->last_name);
+		printf("Personal ID: %d\n", p->id);
+	}
+	
+	if (seen == 0)
+	{
+		printf("I'm sorry, I could not find anyone with ID %d in the database\n\n", pid);
+		return 0;
+	}
+	printf("\n");
+	return 1;
+}
+
+// Remove the person with the ID without needing their name. The index
+// hands us the person, and their cached hash and name lengths make the
+// key for their chain (or probe sequence) without hashing anything.
+int remove_by_id(struct hashtable* h, int pid)
+{
+	struct person* p;
+	struct name_key key;
+	
+	thaw(h);
+	p = id_index_find(h, pid);
+	if (p == NULL)
+		return 0;
+	
+	key.first_name = p->first_name;
+	key.last_name = p->last_name;
+	key.hash = p->hash;
+	key.first_length = p->first_length;
+	key.last_length = p->last_length;
+	return remove_key(h, &key, pid);
+}
+
+static struct radix_node* radix_new_node(const char* label, int label_length)
+{
+	struct radix_node* node;
+	
+	node = calloc(1, sizeof(struct radix_node));
+	node->label = malloc(label_length + 1);
+	memcpy(node->label, label, label_length);
+	node->label[label_length] = '\0';
+	node->label_length = label_length;
+	return node;
+}
+
+// Index of the child whose label starts with c, or where it would go
+// (as -1 - index) if there isn't one
+static int radix_find_child(struct radix_node* node, char c)
+{
+	int low = 0, high = node->num_children - 1, mid;
+	
+	while (low <= high)
+	{
+		mid = (low + high) / 2;
+		if (node->children[mid]->label[0] == c)
+			return mid;
+		if ((unsigned char)node->children[mid]->label[0] < (unsigned char)c)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return -1 - low;
+}
+
+static void radix_add_child(struct radix_node* node, int i, struct radix_node* child)
+{
+	node->children = realloc(node->children, (node->num_children + 1) * sizeof(struct radix_node*));
+	memmove(node->children + i + 1, node->children + i, (node->num_children - i) * sizeof(struct radix_node*));
+	node->children[i] = child;
+	node->num_children++;
+}
+
+static void radix_insert(struct radix_node* node, const char* key, int length, struct person* p)
+{
+	struct radix_node* child;
+	struct radix_node* mid;
+	int i, m;
+	
+	while (length > 0)
+	{
+		i = radix_find_child(node, key[0]);
+		
+		// Case: Nothing starts with this letter yet, the rest of the key is one new edge
+		if (i < 0)
+		{
+			child = radix_new_node(key, length);
+			radix_add_child(node, -1 - i, child);
+			node = child;
+			break;
+		}
+		
+		child = node->children[i];
+		m = 1;
+		while (m < child->label_length && m < length && child->label[m] == key[m])
+			m++;
+		
+		// Case: The key leaves the edge part way along, so split the edge in two there
+		if (m < child->label_length)
+		{
+			mid = radix_new_node(child->label, m);
+			memmove(child->label, child->label + m, child->label_length - m + 1);
+			child->label_length -= m;
+			radix_add_child(mid, 0, child);
+			node->children[i] = mid;
+			child = mid;
+		}
+		
+		node = child;
+		key += m;
+		length -= m;
+	}
+	
+	if (node->num_people == node->people_capacity)
+	{
+		node->people_capacity = node->people_capacity == 0 ? 1 : node->people_capacity * 2;
+		node->people = realloc(node->people, node->people_capacity * sizeof(struct person*));
+	}
+	node->people[node->num_people++] = p;
+}
+
+static void radix_free_node(struct radix_node* node)
+{
+	free(node->label);
+	free(node->children);
+	free(node->people);
+	free(node);
+}
+
+// Take p out from under node. Returns 1 if they were there. On the way back up,
+// a child left with nobody and no children is dropped, and one left with nobody
+// and a single child gets merged with that child so edges stay compressed.
+static int radix_remove(struct radix_node* node, const char* key, int length, struct person* p)
+{
+	struct radix_node* child;
+	struct radix_node* only;
+	char* label;
+	int i;
+	
+	if (length == 0)
+	{
+		for (i = 0; i < node->num_people; i++)
+		{
+			if (node->people[i] == p)
+			{
+				node->people[i] = node->people[--node->num_people];
+				return 1;
+			}
+		}
+		return 0;
+	}
+	
+	i = radix_find_child(node, key[0]);
+	if (i < 0)
+		return 0;
+	child = node->children[i];
+	if (length < child->label_length || memcmp(child->label, key, child->label_length) != 0)
+		return 0;
+	if (!radix_remove(child, key + child->label_length, length - child->label_length, p))
+		return 0;
+	
+	if (child->num_people == 0 && child->num_children == 0)
+	{
+		radix_free_node(child);
+		node->num_children--;
+		memmove(node->children + i, node->children + i + 1, (node->num_children - i) * sizeof(struct radix_node*));
+	}
+	else if (child->num_people == 0 && child->num_children == 1)
+	{
+		only = child->children[0];
+		label = malloc(child->label_length + only->label_length + 1);
+		memcpy(label, child->label, child->label_length);
+		memcpy(label + child->label_length, only->label, only->label_length + 1);
+		free(only->label);
+		only->label = label;
+		only->label_length += child->label_length;
+		node->children[i] = only;
+		radix_free_node(child);
+	}
+	return 1;
+}
+
+static void radix_destroy(struct radix_node* node)
+{
+	int i;
+	
+	if (node == NULL)
+		return;
+	for (i = 0; i < node->num_children; i++)
+		radix_destroy(node->children[i]);
+	radix_free_node(node);
+}
+
+// The node everything starting with prefix lives under, or NULL if nothing does
+static struct radix_node* radix_find_prefix(struct radix_node* node, const char* prefix, int length)
+{
+	struct radix_node* child;
+	int i, m;
+	
+	while (length > 0)
+	{
+		i = radix_find_child(node, prefix[0]);
+		if (i < 0)
+			return NULL;
+		child = node->children[i];
+		m = length < child->label_length ? length : child->label_length;
+		if (memcmp(child->label, prefix, m) != 0)
+			return NULL;
+		node = child;
+		prefix += m;
+		length -= m;
+	}
+	return node;
+}
+
+// Print everyone under node in key order, returns how many there were
+static int radix_print(struct radix_node* node)
+{
+	int i, seen = 0;
+	
+	for (i = 0; i < node->num_people; i++)
+	{
+		printf("Found name: %s %s  ", node->people[i]->first_name, node->people[i]->last_name);
+		printf("Personal ID: %d\n", node->people[i]->id);
+		seen++;
+	}
+	for (i = 0; i < node->num_children; i++)
+		seen += radix_print(node->children[i]);
+	return seen;
+}
+
+// Lowercase up to MAX_LEN - 1 characters of s onto the end of a key
+static int append_folded(char key[], int length, const char* s)
+{
+	int i;
+	
+	for (i = 0; s[i] != '\0' && i < MAX_LEN - 1; i++)
+		key[length++] = tolower((unsigned char)s[i]);
+	return length;
+}
+
+// Build a name index key, major name first. key needs room for 2 * MAX_LEN characters.
+static int name_index_key(const char* major, const char* minor, char key[])
+{
+	int length;
+	
+	length = append_folded(key, 0, major);
+	key[length++] = NAME_SEPARATOR;
+	return append_folded(key, length, minor);
+}
+
+static void name_index_add(struct hashtable* h, struct person* p)
+{
+	char key[2 * MAX_LEN];
+	
+	if (h->by_last == NULL)
+		return;
+	radix_insert(h->by_last, key, name_index_key(p->last_name, p->first_name, key), p);
+	radix_insert(h->by_first, key, name_index_key(p->first_name, p->last_name, key), p);
+}
+
+static void name_index_remove(struct hashtable* h, struct person* p)
+{
+	char key[2 * MAX_LEN];
+	
+	if (h->by_last == NULL)
+		return;
+	radix_remove(h->by_last, key, name_index_key(p->last_name, p->first_name, key), p);
+	radix_remove(h->by_first, key, name_index_key(p->first_name, p->last_name, key), p);
+}
+
+// Build the name indexes the first time a search needs them
+static void build_name_indexes(struct hashtable* h)
+{
+	struct person** people;
+	int i, n;
+	
+	thaw(h);
+	if (h->by_last != NULL)
+		return;
+	
+	h->by_last = radix_new_node("", 0);
+	h->by_first = radix_new_node("", 0);
+	people = malloc((h->num_elements + 1) * sizeof(struct person*));
+	n = gather_people(h, people);
+	for (i = 0; i < n; i++)
+		name_index_add(h, people[i]);
+	free(people);
+}
+
+// Prints everyone with the last name (ignoring case), sorted by first name
+int lookup_last_name(struct hashtable* h, char last_name[])
+{
+	struct radix_node* node;
+	char key[MAX_LEN + 1];
+	int length, seen;
+	
+	build_name_indexes(h);
+	length = append_folded(key, 0, last_name);
+	key[length++] = NAME_SEPARATOR;
+	
+	printf("\n");
+	node = radix_find_prefix(h->by_last, key, length);
+	seen = node != NULL ? radix_print(node) : 0;
+	if (seen == 0)
+	{
+		printf("I'm sorry, I could not find anyone named %s in the database\n\n", last_name);
+		return 0;
+	}
+	printf("\n%d people found\n\n", seen);
+	return 1;
+}
+
+// Prints everyone whose first name starts with prefix (ignoring case), sorted by name
+int lookup_first_prefix(struct hashtable* h, char prefix[])
+{
+	struct radix_node* node;
+	char key[MAX_LEN];
+	int seen;
+	
+	build_name_indexes(h);
+	
+	printf("\n");
+	node = radix_find_prefix(h->by_first, key, append_folded(key, 0, prefix));
+	seen = node != NULL ? radix_print(node) : 0;
+	if (seen == 0)
+	{
+		printf("I'm sorry, I could not find any first names starting with %s in the database\n\n", prefix);
+		return 0;
+	}
+	printf("\n%d people found\n\n", seen);
+	return 1;
+}
+
+
+// Bitmask of the slots in a group whose control byte equals c
+static uint32_t group_match(const signed char* group, signed char c)
+{
+#if defined(__AVX2__)
+	return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+		_mm256_loadu_si256((const __m256i*)group), _mm256_set1_epi8(c)));
+#elif defined(__SSE2__)
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(
+		_mm_loadu_si128((const __m128i*)group), _mm_set1_epi8(c)));
+#else
+	uint32_t mask = 0;
+	int i;
+	for (i = 0; i < GROUP_WIDTH; i++)
+		if (group[i] == c)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+// Bitmask of the slots in a group that are EMPTY or DELETED. Both have
+// their high bit set, so this is just the sign bit of every byte.
+static uint32_t group_match_free(const signed char* group)
+{
+#if defined(__AVX2__)
+	return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)group));
+#elif defined(__SSE2__)
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+	uint32_t mask = 0;
+	int i;
+	for (i = 0; i < GROUP_WIDTH; i++)
+		if (group[i] < 0)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+// Index of the lowest set bit in a group mask
+static int first_bit(uint32_t mask)
+{
+	return __builtin_ctz(mask);
+}
+
+// Allocate empty control bytes and slots for a swiss table of capacity slots
+static void swiss_alloc(struct hashtable* h, int capacity)
+{
+	h->capacity = capacity;
+	h->ctrl = malloc(capacity);
+	memset(h->ctrl, CTRL_EMPTY, capacity);
+	h->slots = malloc(capacity * sizeof(struct slot));
+	// Keep at least 1/8th of the slots EMPTY so every probe terminates
+	h->growth_left = capacity - capacity / 8;
+}
+
+// Find the first EMPTY or DELETED slot along hash's probe sequence.
+// Groups are visited with triangular steps, which covers every group
+// because the number of groups is a power of two.
+static int swiss_find_free(struct hashtable* h, uint64_t hash)
+{
+	int group_mask = h->capacity / GROUP_WIDTH - 1;
+	int group = (int)(hash >> 7) & group_mask;
+	int step = 0;
+	uint32_t mask;
+	
+	while ((mask = group_match_free(h->ctrl + group * GROUP_WIDTH)) == 0)
+	{
+		step++;
+		group = (group + step) & group_mask;
+	}
+	
+	return group * GROUP_WIDTH + first_bit(mask);
+}
+
+// Like swiss_find_free, but give up with -1 as soon as the probe leaves the
+// groups that belong to part (out of num_parts equal runs of groups)
+static int swiss_find_free_in(struct hashtable* h, uint64_t hash, int part, int num_parts)
+{
+	int num_groups = h->capacity / GROUP_WIDTH;
+	int group = (int)(hash >> 7) & (num_groups - 1);
+	int step = 0;
+	uint32_t mask;
+	
+	while ((int64_t)group * num_parts / num_groups == part)
+	{
+		mask = group_match_free(h->ctrl + group * GROUP_WIDTH);
+		if (mask != 0)
+			return group * GROUP_WIDTH + first_bit(mask);
+		step++;
+		group = (group + step) & (num_groups - 1);
+	}
+	return -1;
+}
+
+// Rebuild the table with new_capacity slots. The stored hashes are
+// reused so no names have to be touched while moving people.
+static void swiss_rehash(struct hashtable* h, int new_capacity)
+{
+	signed char* old_ctrl = h->ctrl;
+	struct slot* old_slots = h->slots;
+	int old_capacity = h->capacity;
+	int i, slot;
+	
+	swiss_alloc(h, new_capacity);
+	
+	for (i = 0; i < old_capacity; i++)
+	{
+		if (old_ctrl[i] < 0)
+			continue;
+		
+		slot = swiss_find_free(h, old_slots[i].hash);
+		h->ctrl[slot] = old_ctrl[i];
+		h->slots[slot] = old_slots[i];
+		h->growth_left--;
+	}
+	
+	free(old_ctrl);
+	free(old_slots);
+}
+
+// Insert a person into the open addressing backend
+static void swiss_insert(struct hashtable* h, struct person* p)
+{
+	swiss_insert_hashed(h, p, p->hash);
+}
+
+// Same as swiss_insert when the hash is already known
+static void swiss_insert_hashed(struct hashtable* h, struct person* p, uint64_t hash)
+{
+	int slot;
+	
+	slot = swiss_find_free(h, hash);
+	
+	// Case: We'd use up an EMPTY slot but we've hit the max load. If most of
+	//       the used up slots are DELETED just clean them out, otherwise double.
+	if (h->ctrl[slot] == CTRL_EMPTY && h->growth_left == 0)
+	{
+		if (h->num_elements < h->capacity * 7 / 16)
+			swiss_rehash(h, h->capacity);
+		else
+			swiss_rehash(h, h->capacity * 2);
+		slot = swiss_find_free(h, hash);
+	}
+	
+	if (h->ctrl[slot] == CTRL_EMPTY)
+		h->growth_left--;
+	
+	h->ctrl[slot] = (signed char)(hash & 0x7f);
+	h->slots[slot].hash = hash;
+	h->slots[slot].p = p;
+	h->num_elements++;
+}
+
+// Where a lookup is along a hash's probe sequence
+struct probe {
+	int group;
+	int step;
+	uint32_t mask;
+};
+
+// Start probing at the hash's home group
+static void probe_start(struct hashtable* h, uint64_t hash, struct probe* pr)
+{
+	pr->group = (int)(hash >> 7) & (h->capacity / GROUP_WIDTH - 1);
+	pr->step = 0;
+	pr->mask = group_match(h->ctrl + pr->group * GROUP_WIDTH, (signed char)(hash & 0x7f));
+}
+
+// Return the next slot along the probe sequence holding the name, or -1 once
+// we've reached a group with an EMPTY slot since the name can't be past it.
+static int probe_next(struct hashtable* h, struct name_key* key, struct probe* pr)
+{
+	int slot;
+	
+	for (;;)
+	{
+		// Only slots with the same 7 bit tag are candidates, and only those
+		// with the same full hash make us go out and look at the person.
+		while (pr->mask != 0)
+		{
+			slot = pr->group * GROUP_WIDTH + first_bit(pr->mask);
+			pr->mask &= pr->mask - 1;
+			
+			if (h->slots[slot].hash == key->hash && has_key(h->slots[slot].p, key))
+				return slot;
+		}
+		
+		if (group_match(h->ctrl + pr->group * GROUP_WIDTH, CTRL_EMPTY) != 0)
+			return -1;
+		
+		pr->step++;
+		pr->group = (pr->group + pr->step) & (h->capacity / GROUP_WIDTH - 1);
+		pr->mask = group_match(h->ctrl + pr->group * GROUP_WIDTH, (signed char)(key->hash & 0x7f));
+	}
+}
+
+// Prints all people in the open addressing backend matching the name
+static int swiss_lookup(struct hashtable* h, char first_name[], char last_name[])
+{
+	struct name_key key;
+	struct probe pr;
+	int slot, seen;
+	
+	make_key(h, first_name, last_name, &key);
+	probe_start(h, key.hash, &pr);
+	
+	seen = 0;
+	printf("\n");
+	while ((slot = probe_next(h, &key, &pr)) >= 0)
+	{
+		seen = 1;
+		printf("Found name: %s %s  ", h->slots[slot].p->first_name, h->slots[slot].p->last_name);
+		printf("Personal ID: %d\n", h->slots[slot].p->id);
+	}
+	
+	if (seen == 0)
+	{
+		printf("I'm sorry, I could not find %s %s in the database\n\n", first_name, last_name);
+		return 0;
+	}
+	printf("\n");
+	return 1;
+}
+
+// Remove the person with the name and ID from the open addressing backend
+static int swiss_remove(struct hashtable* h, struct name_key* key, int pid)
+{
+	struct probe pr;
+	int slot, group_start;
+	
+	probe_start(h, key->hash, &pr);
+	while ((slot = probe_next(h, key, &pr)) >= 0 && h->slots[slot].p->id != pid)
+		;
+	if (slot < 0)
+		return 0;
+	
+	id_index_remove(h, h->slots[slot].p);
+	name_index_remove(h, h->slots[slot].p);
+	release_person(h, h->slots[slot].p);
+	
+	// If the slot's group still has an EMPTY slot then no probe ever continued
+	// past this group, so the slot can go straight back to EMPTY. Otherwise
+	// leave a DELETED tombstone so later probes keep going.
+	group_start = slot - slot % GROUP_WIDTH;
+	if (group_match(h->ctrl + group_start, CTRL_EMPTY) != 0)
+	{
+		h->ctrl[slot] = CTRL_EMPTY;
+		h->growth_left++;
+	}
+	else
+		h->ctrl[slot] = CTRL_DELETED;
+	
+	h->num_elements--;
+	return 1;
+}
+
+
+// Free all memory allocated to hash table and it's elements
+void delete_hashtable(struct hashtable* h) 
+{
+	int i;
+	struct person* temp;
+	struct person* current_node;
+	
+	// Pull in anyone still waiting in the old array so there is only one array to free
+	finish_rehash(h);
+	
+	// With a slab every person goes away at once with the slab
+	if (h->pool != NULL)
+		slab_destroy(h->pool);
+	else
+	{
+		// Open addressing backend: free everyone in a full slot
+		for (i = 0; i < h->capacity; i++)
+			if (h->ctrl[i] >= 0)
+				free(h->slots[i].p);
+		
+		for (i = 0; i < h->length; i++)
+		{
+			current_node = h->store[i];	
+			while (current_node != NULL) 
+			{
+				// Free the people!
+				temp = current_node;
+				current_node = current_node->next;
+				free(temp);
+			}
+		}
+	}
+	
+	// Free the arrays of people
+	free(h->store);
+	free(h->ctrl);
+	free(h->slots);
+	free(h->by_id);
+	radix_destroy(h->by_last);
+	radix_destroy(h->by_first);
+	// Free the hash table
+	free(h);
+ } 
+ 
+ void print_table(struct hashtable* h)
+ {
+	int i;
+	struct person* current_node;
+	
+	// Printing walks every bucket anyway, so finish any pending resize first
+	thaw(h);
+	finish_rehash(h);
+	
+	if (h->backend == BACKEND_SWISS)
+	{
+		for (i = 0; i < h->capacity; i++)
+		{
+			if (h->ctrl[i] < 0)
+				continue;
+			current_node = h->slots[i].p;
+			printf("Slot %d (group %d): %s %s ID: %d\n", i, i / GROUP_WIDTH,
+				   current_node->first_name, current_node->last_name, current_node->id);
+		}
+		printf("\n%d people in %d slots\n\n", h->num_elements, h->capacity);
+		return;
+	}
 	
 	for (i = 0; i < h->length; i++)
 	{
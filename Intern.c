@@ -0,0 +1,208 @@
+/*
+** String interning pool shared by the data structures, see Intern.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Intern.h"
+
+// Aim for blocks of about this many bytes, a longer string gets a block of its own
+#define INTERN_BLOCK_BYTES 16384
+// Slots in a new pool's table, grows once it's 3/4 full
+#define INTERN_INITIAL_CAPACITY 64
+
+struct intern_block {
+	struct intern_block* next;
+	size_t size; // Bytes in data
+	// Every copy in data is an intern_header followed by the string and its '\0'
+	char data[];
+};
+
+// Sits right in front of every copy
+struct intern_header {
+	uint32_t length;
+	uint32_t hash;
+};
+
+// Round n up to a multiple of align (a power of two)
+#define ROUND_UP(n, align) (((n) + (align) - 1) & ~(size_t)((align) - 1))
+
+static struct intern_header* header_of(const char* s)
+{
+	return (struct intern_header*)s - 1;
+}
+
+// FNV-1a, the pool only needs it to spread strings over its table
+static uint32_t hash_bytes(const char* s, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+	
+	for (i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)s[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Create an empty pool. No blocks are grabbed until the first string.
+struct intern_pool* intern_create(void)
+{
+	struct intern_pool* pool;
+	
+	pool = malloc(sizeof(struct intern_pool));
+	pool->capacity = INTERN_INITIAL_CAPACITY;
+	pool->table = calloc(pool->capacity, sizeof(const char*));
+	pool->count = 0;
+	pool->blocks = NULL;
+	pool->block_used = 0;
+	pool->block_size = 0;
+	pool->requests = 0;
+	pool->bytes = 0;
+	return pool;
+}
+
+// Slot holding the copy of s, or the free slot it would go in
+static int find_slot(struct intern_pool* pool, const char* s, size_t length, uint32_t hash)
+{
+	int slot = hash & (pool->capacity - 1);
+	const char* copy;
+	
+	while ((copy = pool->table[slot]) != NULL)
+	{
+		// Only go out to the bytes when the hash and length already match
+		if (header_of(copy)->hash == hash && header_of(copy)->length == length &&
+			memcmp(copy, s, length) == 0)
+			break;
+		slot = (slot + 1) & (pool->capacity - 1);
+	}
+	return slot;
+}
+
+// Double the table, the stored hashes mean no string is looked at again
+static void grow(struct intern_pool* pool)
+{
+	const char** old_table = pool->table;
+	int old_capacity = pool->capacity;
+	int i, slot;
+	
+	pool->capacity *= 2;
+	pool->table = calloc(pool->capacity, sizeof(const char*));
+	for (i = 0; i < old_capacity; i++)
+	{
+		if (old_table[i] == NULL)
+			continue;
+		slot = header_of(old_table[i])->hash & (pool->capacity - 1);
+		while (pool->table[slot] != NULL)
+			slot = (slot + 1) & (pool->capacity - 1);
+		pool->table[slot] = old_table[i];
+	}
+	free(old_table);
+}
+
+// Carve a copy of s out of the newest block, starting a new one if it's full
+static const char* store_copy(struct intern_pool* pool, const char* s, size_t length, uint32_t hash)
+{
+	struct intern_block* block;
+	struct intern_header* header;
+	size_t needed;
+	char* copy;
+	
+	needed = ROUND_UP(sizeof(struct intern_header) + length + 1, sizeof(struct intern_header));
+	if (pool->blocks == NULL || pool->block_used + needed > pool->block_size)
+	{
+		pool->block_size = needed > INTERN_BLOCK_BYTES ? needed : INTERN_BLOCK_BYTES;
+		block = malloc(sizeof(struct intern_block) + pool->block_size);
+		block->size = pool->block_size;
+		block->next = pool->blocks;
+		pool->blocks = block;
+		pool->block_used = 0;
+	}
+	
+	header = (struct intern_header*)(pool->blocks->data + pool->block_used);
+	header->length = length;
+	header->hash = hash;
+	copy = (char*)(header + 1);
+	memcpy(copy, s, length);
+	copy[length] = '\0';
+	pool->block_used += needed;
+	pool->bytes += length;
+	return copy;
+}
+
+// Return the pool's copy of the first length chars of s, adding it if needed
+const char* intern_n(struct intern_pool* pool, const char* s, size_t length)
+{
+	uint32_t hash = hash_bytes(s, length);
+	int slot;
+	
+	pool->requests++;
+	slot = find_slot(pool, s, length, hash);
+	if (pool->table[slot] != NULL)
+		return pool->table[slot];
+	
+	// Keep at least a quarter of the slots free so probes stay short
+	if ((pool->count + 1) * 4 > pool->capacity * 3)
+	{
+		grow(pool);
+		slot = find_slot(pool, s, length, hash);
+	}
+	
+	pool->table[slot] = store_copy(pool, s, length, hash);
+	pool->count++;
+	return pool->table[slot];
+}
+
+// Return the pool's copy of s, adding it if needed
+const char* intern(struct intern_pool* pool, const char* s)
+{
+	return intern_n(pool, s, strlen(s));
+}
+
+// Return the pool's copy of s, or NULL if it was never interned. Anything
+// compared against interned strings can be looked up with this first: if
+// it isn't in the pool, it can't be equal to any of them.
+const char* intern_find(struct intern_pool* pool, const char* s)
+{
+	size_t length = strlen(s);
+	
+	return pool->table[find_slot(pool, s, length, hash_bytes(s, length))];
+}
+
+// Length of an interned string, without walking it
+size_t intern_length(const char* s)
+{
+	return header_of(s)->length;
+}
+
+// The pool's hash of an interned string
+uint32_t intern_hash(const char* s)
+{
+	return header_of(s)->hash;
+}
+
+// Free every block (and so every copy) of the pool at once
+void intern_destroy(struct intern_pool* pool)
+{
+	struct intern_block* temp;
+	
+	while (pool->blocks != NULL)
+	{
+		temp = pool->blocks;
+		pool->blocks = pool->blocks->next;
+		free(temp);
+	}
+	
+	free(pool->table);
+	free(pool);
+}
+
+void intern_print_stats(struct intern_pool* pool, const char* name)
+{
+	printf("\n%s pool: %d distinct strings out of %ld interned\n", name, pool->count, pool->requests);
+	printf("String bytes: %ld (%ld with prefixes)\n", pool->bytes,
+		   pool->bytes + (long)(pool->count * (sizeof(struct intern_header) + 1)));
+	printf("Table: %d of %d slots used\n\n", pool->count, pool->capacity);
+}
@@ -0,0 +1,49 @@
+/*
+** String interning pool shared by the data structures
+**
+** Interning a string hands back the pool's one copy of it, so every node
+** holding the same name points at the same bytes. Two interned strings from
+** the same pool are equal exactly when their pointers are, which turns name
+** equality checks into a pointer compare instead of a strcmp.
+**
+** Each copy is stored length prefixed (with its hash) in big blocks, and is
+** still '\0' terminated so it can be printed or strcmp'd like any string.
+** Strings stay in the pool until the whole pool is destroyed.
+**
+** Time Complexity
+** Intern:  O(length) expected (Hash the string and probe the pool's table)
+** Find:    O(length) expected (Same, but never adds the string)
+** Length:  O(1) (Read from the prefix)
+** Destroy: O(b) where b is the number of blocks, not the number of strings
+*/
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct intern_block;
+
+struct intern_pool {
+	const char** table;          // Open addressing table of the copies, NULL for a free slot
+	int capacity;                // Slots in table, a power of two
+	int count;                   // Strings in the pool
+	struct intern_block* blocks; // Newest block first, copies are carved from it
+	size_t block_used;
+	size_t block_size;
+	// Stats
+	long requests;               // Calls to intern, count of them got a new copy
+	long bytes;                  // Bytes of names stored, not counting prefixes
+};
+
+struct intern_pool* intern_create(void);
+const char* intern(struct intern_pool* pool, const char* s);
+const char* intern_n(struct intern_pool* pool, const char* s, size_t length);
+const char* intern_find(struct intern_pool* pool, const char* s);
+size_t intern_length(const char* s);
+uint32_t intern_hash(const char* s);
+void intern_destroy(struct intern_pool* pool);
+void intern_print_stats(struct intern_pool* pool, const char* name);
+
+#endif
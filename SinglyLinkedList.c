@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "Slab.h"
+#include "Intern.h"
 
 /*
 ** Author: Stephen Sheldon 3/7/2019
@@ -11,40 +14,108 @@
 ** Delete: O(n) (This is assuming we are deleting a name from the list, we don't know where it
 **				 is thus we need to traverse the list till we find it
 ** Search: O(n) (See above, because search is O(n) is why insert is O(n) for insert and delete)
+** Bulk load: O(n) for names that are already sorted (see insert_sorted)
+**
+** A list can also be created with a skip list index over it. Besides the regular
+** chain, about 1 in 4 nodes is also linked into a first express lane, 1 in 4 of
+** those into a second lane and so on. Searches run along the highest lane until the
+** next node would overshoot, then drop down a lane, so they only look at a few nodes
+** per lane. That makes insert, delete and search O(log n) expected. The chain itself
+** is untouched, so printing and bulk loading work the same as before.
+** Run the program with "skip" to get the index.
+**
+** Nodes don't hold their names, they point at the list's interned copy (see Intern.h).
+** A name that's in the list a hundred times is stored once, a node is 32 bytes instead
+** of 128, and checking whether a node has the name we're after is a pointer compare.
 */
 #define MAX_LENGTH 100
+// Plenty of lanes for 4^16 names
+#define MAX_LANES 16
 
 struct list {
 	struct node* head;
+	struct slab* pool; // Nodes come from here if the list opted into a slab
+	struct intern_pool* names; // Every node's name is this pool's copy
+	int indexed;       // Keep a skip list index over the chain
+	int num_lanes;     // Number of express lanes in use
+	struct node* lanes[MAX_LANES]; // First node in each express lane
 };
 struct node {
-	char name[MAX_LENGTH];
+	const char* name; // Interned, so equal names are the same pointer
 	struct node* next;
+	int num_lanes;       // How many express lanes this node is in
+	struct node** lanes; // Next node in each of them, NULL if it's in none
 };
 
-struct list* create_list(void);
+struct list* create_list(int use_slab, int indexed);
 void insert(struct list* linked_list, char name[]);
+int find(struct list* linked_list, char name[]);
 void print_list(struct list* linked_list);
 int delete_node(struct list* linked_list, char name[]);
 void delete_list(struct list* linked_list);
+void insert_sorted(struct list* linked_list, char* names[], int count);
+int load_file(struct list* linked_list, const char* filename);
+void build_index(struct list* linked_list);
 
 
-// Create a new empty List
-struct list* create_list(void)
+// Create a new empty List, with its own slab of nodes if use_slab is set
+// and with a skip list index if indexed is set
+struct list* create_list(int use_slab, int indexed)
 {
 	struct list* new_list;
 	// Allocate memory for head pointer
 	new_list = malloc(sizeof(struct list));
 	// Set the head to null as no items are currently in the list
 	new_list->head = NULL;
+	new_list->pool = use_slab ? slab_create(sizeof(struct node)) : NULL;
+	new_list->names = intern_create();
+	new_list->indexed = indexed;
+	new_list->num_lanes = 0;
 	
 	return new_list;
 }
 
+// Allocate a node from the list's slab, or malloc if it doesn't have one.
+// The node starts out in no express lanes.
+static struct node* alloc_node(struct list* linked_list)
+{
+	struct node* node;
+	
+	if (linked_list->pool != NULL)
+		node = slab_alloc(linked_list->pool);
+	else
+		node = malloc(sizeof(struct node));
+	node->num_lanes = 0;
+	node->lanes = NULL;
+	return node;
+}
+
+// Give a node back to wherever it was allocated from
+static void release_node(struct list* linked_list, struct node* node)
+{
+	free(node->lanes);
+	if (linked_list->pool != NULL)
+		slab_free(linked_list->pool, node);
+	else
+		free(node);
+}
+
 void delete_list(struct list* linked_list)
 {
 	struct node* current_node;
 	
+	// With a slab every node goes away at once with the slab,
+	// but their express lanes were malloced separately
+	if (linked_list->pool != NULL)
+	{
+		for (current_node = linked_list->head; current_node != NULL; current_node = current_node->next)
+			free(current_node->lanes);
+		slab_destroy(linked_list->pool);
+		intern_destroy(linked_list->names);
+		free(linked_list);
+		return;
+	}
+	
 	while (linked_list->head != NULL)
 	{
 		current_node = linked_list->head;
@@ -52,26 +123,193 @@ void delete_list(struct list* linked_list)
 		// after the first node
 		linked_list->head = linked_list->head->next;
 		// free the current node;
+		free(current_node->lanes);
 		free(current_node);
 	}
 	// Finally free up the memory allocated to the list	
+	intern_destroy(linked_list->names);
 	free(linked_list);
 }
 
+// The link that follows node in a lane, lane 0 being the regular chain.
+// A NULL node stands for the head of the list.
+static struct node** link_in_lane(struct list* linked_list, struct node* node, int lane)
+{
+	if (lane == 0)
+		return node == NULL ? &linked_list->head : &node->next;
+	return node == NULL ? &linked_list->lanes[lane - 1] : &node->lanes[lane - 1];
+}
+
+// Walk down the lanes towards name. For every lane, path gets the last node
+// before name (NULL for the head), which is where a node for name would go.
+static void skip_search(struct list* linked_list, char name[], struct node* path[])
+{
+	struct node* node = NULL;
+	struct node* next;
+	int lane;
+	
+	for (lane = linked_list->num_lanes; lane >= 0; lane--)
+	{
+		while ((next = *link_in_lane(linked_list, node, lane)) != NULL && strcmp(next->name, name) < 0)
+			node = next;
+		path[lane] = node;
+	}
+}
+
+// Pick how many express lanes a new node joins, each one with probability 1/4
+static int random_lanes(void)
+{
+	int lanes = 0;
+	
+	while (lanes < MAX_LANES && (rand() & 3) == 0)
+		lanes++;
+	return lanes;
+}
+
+// Link node into its first num_lanes express lanes after the nodes in path
+static void join_lanes(struct list* linked_list, struct node* node, int num_lanes, struct node* path[])
+{
+	int lane;
+	
+	if (num_lanes == 0)
+		return;
+	
+	// Case: The node is taller than every other node, the head
+	//       is the only thing before it in the new lanes
+	for (lane = linked_list->num_lanes + 1; lane <= num_lanes; lane++)
+	{
+		path[lane] = NULL;
+		linked_list->lanes[lane - 1] = NULL;
+	}
+	if (num_lanes > linked_list->num_lanes)
+		linked_list->num_lanes = num_lanes;
+	
+	node->num_lanes = num_lanes;
+	node->lanes = malloc(num_lanes * sizeof(struct node*));
+	for (lane = 1; lane <= num_lanes; lane++)
+	{
+		node->lanes[lane - 1] = *link_in_lane(linked_list, path[lane], lane);
+		*link_in_lane(linked_list, path[lane], lane) = node;
+	}
+}
+
+static void skip_insert(struct list* linked_list, char name[])
+{
+	struct node* path[MAX_LANES + 1];
+	struct node* new_node;
+	
+	skip_search(linked_list, name, path);
+	
+	new_node = alloc_node(linked_list);
+	new_node->name = intern(linked_list->names, name);
+	new_node->next = *link_in_lane(linked_list, path[0], 0);
+	*link_in_lane(linked_list, path[0], 0) = new_node;
+	join_lanes(linked_list, new_node, random_lanes(), path);
+}
+
+static int skip_delete(struct list* linked_list, char name[])
+{
+	struct node* path[MAX_LANES + 1];
+	struct node* node;
+	const char* interned;
+	int lane;
+	
+	// Case: The name was never interned, so no node can have it
+	interned = intern_find(linked_list->names, name);
+	if (interned == NULL)
+		return 0;
+	
+	skip_search(linked_list, name, path);
+	
+	node = *link_in_lane(linked_list, path[0], 0);
+	if (node == NULL || node->name != interned)
+		return 0;
+	
+	// Unhook the node from every lane it's in. Equal names can be spread
+	// over a lane, so only unhook it where it's really the next node.
+	for (lane = 0; lane <= node->num_lanes; lane++)
+	{
+		while (*link_in_lane(linked_list, path[lane], lane) != node)
+			path[lane] = *link_in_lane(linked_list, path[lane], lane);
+		*link_in_lane(linked_list, path[lane], lane) = *link_in_lane(linked_list, node, lane);
+	}
+	
+	// Drop lanes that are empty now
+	while (linked_list->num_lanes > 0 && linked_list->lanes[linked_list->num_lanes - 1] == NULL)
+		linked_list->num_lanes--;
+	
+	release_node(linked_list, node);
+	return 1;
+}
+
+// Search the list for a name, returns 1 if it's there
+int find(struct list* linked_list, char name[])
+{
+	struct node* path[MAX_LANES + 1];
+	struct node* node;
+	const char* interned;
+	
+	// Case: The name was never interned, so no node can have it
+	interned = intern_find(linked_list->names, name);
+	if (interned == NULL)
+		return 0;
+	
+	// Without the index this is just a walk down the chain
+	skip_search(linked_list, name, path);
+	node = *link_in_lane(linked_list, path[0], 0);
+	return node != NULL && node->name == interned;
+}
+
+// Throw away the express lanes and build them again from scratch in one
+// pass over the chain. Used after bulk loads, which only add to the chain.
+void build_index(struct list* linked_list)
+{
+	struct node* last[MAX_LANES + 1];
+	struct node* node;
+	int lane;
+	
+	for (node = linked_list->head; node != NULL; node = node->next)
+	{
+		free(node->lanes);
+		node->lanes = NULL;
+		node->num_lanes = 0;
+	}
+	linked_list->num_lanes = 0;
+	
+	if (!linked_list->indexed)
+		return;
+	
+	// Going in order, every node joins its lanes right after the last
+	// node seen in each of them, so last works just like a search path
+	for (lane = 0; lane <= MAX_LANES; lane++)
+		last[lane] = NULL;
+	for (node = linked_list->head; node != NULL; node = node->next)
+	{
+		join_lanes(linked_list, node, random_lanes(), last);
+		for (lane = 1; lane <= node->num_lanes; lane++)
+			last[lane] = node;
+	}
+}
+
 int delete_node(struct list* linked_list, char name[])
 {
 	struct node* current_node;
 	struct node* temp;
+	const char* interned;
+	
+	if (linked_list->indexed)
+		return skip_delete(linked_list, name);
 	
 	current_node = linked_list->head;
-	if (linked_list->head == NULL)
+	interned = intern_find(linked_list->names, name);
+	if (linked_list->head == NULL || interned == NULL)
 		return 0;
 		
-	if (strcmp(linked_list->head->name, name) == 0)
+	if (linked_list->head->name == interned)
 	{
 		temp = linked_list->head;
 		linked_list->head = linked_list->head->next;
-		free(temp);
+		release_node(linked_list, temp);
 		return 1;
 	}
 		
@@ -80,13 +318,13 @@ int delete_node(struct list* linked_list, char name[])
 	while (current_node->next != NULL && strcmp(current_node->next->name, name) < 0)
 		current_node = current_node->next;
 	
-	if (current_node->next == NULL || strcmp(current_node->next->name, name) != 0)
+	if (current_node->next == NULL || current_node->next->name != interned)
 		return 0;
 	
 	// We've found the matching node
 	temp = current_node->next;
 	current_node->next = current_node->next->next;
-	free(temp);
+	release_node(linked_list, temp);
 	return 1;
 }
 
@@ -97,11 +335,17 @@ void insert(struct list* linked_list, char name[])
 	struct node* new_node;
 	struct node* current_node;
 	
+	if (linked_list->indexed)
+	{
+		skip_insert(linked_list, name);
+		return;
+	}
+	
 	// Initialize memory for new node
-	new_node = malloc(sizeof(struct node));
+	new_node = alloc_node(linked_list);
 	
-	// Copy the name into the node
-	strcpy(new_node->name, name);
+	// Point the node at the pool's copy of the name
+	new_node->name = intern(linked_list->names, name);
 
 	// Check if head is null or if the new node's name 
 	// comes before the first node's name
@@ -124,6 +368,74 @@ void insert(struct list* linked_list, char name[])
 	current_node->next = new_node;
 }
 
+// Insert name somewhere after the node after (or anywhere if after is NULL),
+// keeping the list sorted, and return the new node. Feeding each new node
+// back in as after makes it the tail of a batch being appended, so for
+// sorted names the next one usually goes right after it with no searching.
+static struct node* insert_after(struct list* linked_list, struct node* after, char name[])
+{
+	struct node* new_node;
+	struct node** link;
+	
+	new_node = alloc_node(linked_list);
+	new_node->name = intern(linked_list->names, name);
+	
+	// Case: Name comes before after, so start over from the head
+	if (after != NULL && strcmp(after->name, name) > 0)
+		after = NULL;
+	
+	link = after == NULL ? &linked_list->head : &after->next;
+	while (*link != NULL && strcmp((*link)->name, name) < 0)
+		link = &(*link)->next;
+	
+	new_node->next = *link;
+	*link = new_node;
+	return new_node;
+}
+
+// Add count names at once. If the names are already sorted the whole
+// batch is merged into the list in one pass, O(n + count) instead of a
+// full scan per name. Names that are out of order still end up in the
+// right place, they just cost a scan from the head. An index gets
+// rebuilt afterwards, which is also one pass.
+void insert_sorted(struct list* linked_list, char* names[], int count)
+{
+	struct node* tail = NULL;
+	int i;
+	
+	for (i = 0; i < count; i++)
+		tail = insert_after(linked_list, tail, names[i]);
+	
+	if (linked_list->indexed)
+		build_index(linked_list);
+}
+
+// Same as insert_sorted but streams the names out of a file, one per word.
+// Returns the number of names read, or -1 if the file couldn't be opened.
+int load_file(struct list* linked_list, const char* filename)
+{
+	FILE* fp;
+	struct node* tail = NULL;
+	char name[MAX_LENGTH];
+	int count = 0;
+	
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	
+	while (fscanf(fp, "%99s", name) == 1)
+	{
+		tail = insert_after(linked_list, tail, name);
+		count++;
+	}
+	
+	fclose(fp);
+	
+	if (linked_list->indexed)
+		build_index(linked_list);
+	return count;
+}
+
 void print_list(struct list* linked_list)
 {
 	struct node* current_node;
@@ -140,13 +452,16 @@ void print_list(struct list* linked_list)
 	printf("\n\n");
 }
 
-int main() 
+int main(int argc, char* argv[]) 
 {
-	int choice;
+	int choice, count;
 	char name[MAX_LENGTH];
+	char filename[256];
+	clock_t start;
 	
 	struct list* linked_list;
-	linked_list = create_list();
+	// Plain list unless "skip" was asked for
+	linked_list = create_list(1, argc > 1 && strcmp(argv[1], "skip") == 0);
 	
 	printf("Welcome to the names database!\n");
 	printf("We're happy to store all the names you like.\n");
@@ -156,6 +471,9 @@ int main()
 		printf("1. Add a name to the list.\n");
 		printf("2. Print the list\n");
 		printf("3. Delete name from the list\n");
+		printf("4. Print allocation stats\n");
+		printf("5. Load names from a sorted file\n");
+		printf("6. Look up a name\n");
 		printf("0. Exit the program\n");
 		scanf("%d", &choice);
 		
@@ -176,6 +494,31 @@ int main()
 			else
 				printf("Sorry I could not find %s in the list\n", name);
 		}
+		else if (choice == 4)
+		{
+			slab_print_stats(linked_list->pool, "Node");
+			intern_print_stats(linked_list->names, "Name");
+		}
+		else if (choice == 5)
+		{
+			printf("Please enter the file you wish to load\n");
+			scanf("%255s", filename);
+			start = clock();
+			count = load_file(linked_list, filename);
+			if (count < 0)
+				printf("Sorry I could not open %s\n", filename);
+			else
+				printf("Loaded %d names in %.3f ms\n", count, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+		}
+		else if (choice == 6)
+		{
+			printf("Please enter the name you wish to look up\n");
+			scanf("%s", name);
+			if (find(linked_list, name))
+				printf("%s is in the list!\n", name);
+			else
+				printf("Sorry I could not find %s in the list\n", name);
+		}
 	} while (choice != 0);
 	
 	delete_list(linked_list);
@@ -0,0 +1,169 @@
+/*
+** Slab allocator shared by the data structures, see Slab.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Slab.h"
+
+// Aim for chunks of about this many bytes
+#define SLAB_CHUNK_BYTES 16384
+// Unless asked for otherwise every object is aligned to this
+#define SLAB_ALIGN 8
+
+struct slab_chunk {
+	struct slab_chunk* next;
+};
+
+// Round n up to a multiple of align (a power of two)
+#define ROUND_UP(n, align) (((n) + (align) - 1) & ~(size_t)((align) - 1))
+
+// Create an empty slab for objects of object_size bytes. No memory for
+// objects is grabbed until the first allocation.
+struct slab* slab_create(size_t object_size)
+{
+	return slab_create_aligned(object_size, SLAB_ALIGN);
+}
+
+// Same as slab_create, but every object starts on a multiple of align
+// bytes (a power of two), e.g. 64 to keep objects on cache line boundaries
+struct slab* slab_create_aligned(size_t object_size, size_t align)
+{
+	struct slab* s;
+	
+	s = malloc(sizeof(struct slab));
+	
+	if (align < SLAB_ALIGN)
+		align = SLAB_ALIGN;
+	// Free objects store the free list link in themselves, so they
+	// need to at least fit a pointer
+	if (object_size < sizeof(void*))
+		object_size = sizeof(void*);
+	s->align = align;
+	s->object_size = ROUND_UP(object_size, align);
+	// Objects start after the chunk header, rounded up to the alignment
+	s->header_size = ROUND_UP(sizeof(struct slab_chunk), align);
+	
+	s->objects_per_chunk = (SLAB_CHUNK_BYTES - s->header_size) / s->object_size;
+	if (s->objects_per_chunk < 16)
+		s->objects_per_chunk = 16;
+	
+	s->chunks = NULL;
+	s->free_list = NULL;
+	s->next_unused = s->objects_per_chunk;
+	s->live = 0;
+	s->high_water = 0;
+	s->num_chunks = 0;
+	return s;
+}
+
+// Hand out one object, reusing a freed one if there is any
+void* slab_alloc(struct slab* s)
+{
+	struct slab_chunk* chunk;
+	void* object;
+	
+	// Case: Reuse the most recently freed object
+	if (s->free_list != NULL)
+	{
+		object = s->free_list;
+		s->free_list = *(void**)object;
+	}
+	else
+	{
+		// Case: The newest chunk is used up, grab a new one
+		if (s->next_unused == s->objects_per_chunk)
+		{
+			chunk = aligned_alloc(s->align, ROUND_UP(s->header_size + s->objects_per_chunk * s->object_size, s->align));
+			chunk->next = s->chunks;
+			s->chunks = chunk;
+			s->next_unused = 0;
+			s->num_chunks++;
+		}
+		
+		object = (char*)s->chunks + s->header_size + s->next_unused * s->object_size;
+		s->next_unused++;
+	}
+	
+	s->live++;
+	if (s->live > s->high_water)
+		s->high_water = s->live;
+	
+	return object;
+}
+
+// Give an object back to the slab it came from
+void slab_free(struct slab* s, void* object)
+{
+	*(void**)object = s->free_list;
+	s->free_list = object;
+	s->live--;
+}
+
+// Free every chunk (and so every object) of the slab at once
+void slab_destroy(struct slab* s)
+{
+	struct slab_chunk* temp;
+	
+	while (s->chunks != NULL)
+	{
+		temp = s->chunks;
+		s->chunks = s->chunks->next;
+		free(temp);
+	}
+	
+	free(s);
+}
+
+// Move every chunk and free object of from into into, then destroy from.
+// Both have to be for the same object size and alignment. Objects from
+// from stay where they are and are freed back to into from now on. This
+// lets threads fill slabs of their own and hand them over when done.
+void slab_merge(struct slab* into, struct slab* from)
+{
+	struct slab_chunk* last;
+	void** link;
+	
+	if (from->chunks != NULL)
+	{
+		// Case: into has nothing yet, take over from's newest chunk as is
+		if (into->chunks == NULL)
+		{
+			into->chunks = from->chunks;
+			into->next_unused = from->next_unused;
+		}
+		// Otherwise keep into's newest chunk in front. Whatever from never
+		// handed out of its newest chunk is simply left unused.
+		else
+		{
+			for (last = from->chunks; last->next != NULL; last = last->next)
+				;
+			last->next = into->chunks->next;
+			into->chunks->next = from->chunks;
+		}
+	}
+	
+	if (from->free_list != NULL)
+	{
+		for (link = from->free_list; *link != NULL; link = *link)
+			;
+		*link = into->free_list;
+		into->free_list = from->free_list;
+	}
+	
+	into->live += from->live;
+	into->num_chunks += from->num_chunks;
+	if (into->live > into->high_water)
+		into->high_water = into->live;
+	
+	free(from);
+}
+
+void slab_print_stats(struct slab* s, const char* name)
+{
+	printf("\n%s slab: %ld byte objects, %d per chunk\n", name, (long)s->object_size, s->objects_per_chunk);
+	printf("Live objects: %ld (%ld bytes)\n", s->live, s->live * (long)s->object_size);
+	printf("High water mark: %ld objects\n", s->high_water);
+	printf("Chunks: %ld (%ld bytes reserved)\n\n", s->num_chunks,
+		   s->num_chunks * (long)(s->header_size + s->objects_per_chunk * s->object_size));
+}
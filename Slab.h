@@ -0,0 +1,47 @@
+/*
+** Slab allocator shared by the data structures
+**
+** A slab hands out fixed size objects carved from big chunks instead of
+** calling malloc for every node. Freed objects go on the slab's free list
+** and get reused by the next allocation, and the whole slab (every chunk)
+** can be thrown away at once when the structure using it is deleted.
+**
+** Each structure that opts in owns its own slab, so nodes of one list
+** never get mixed in with nodes of another.
+**
+** Time Complexity
+** Alloc:   O(1) (One malloc per chunk of objects instead of per object)
+** Free:    O(1) (Just pushes the object on the free list)
+** Destroy: O(c) where c is the number of chunks, not the number of objects
+*/
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+struct slab_chunk;
+
+struct slab {
+	size_t object_size;      // Rounded up so a free object can hold the free list link
+	size_t align;            // Every object starts on a multiple of this
+	size_t header_size;      // Chunk header rounded up to the alignment
+	int objects_per_chunk;
+	struct slab_chunk* chunks;
+	void* free_list;
+	int next_unused;         // Objects in the newest chunk never handed out yet start here
+	// Stats
+	long live;               // Objects currently handed out
+	long high_water;         // Most objects ever handed out at once
+	long num_chunks;
+};
+
+struct slab* slab_create(size_t object_size);
+struct slab* slab_create_aligned(size_t object_size, size_t align);
+void* slab_alloc(struct slab* s);
+void slab_free(struct slab* s, void* object);
+void slab_destroy(struct slab* s);
+void slab_merge(struct slab* into, struct slab* from);
+void slab_print_stats(struct slab* s, const char* name);
+
+#endif
@@ -0,0 +1,305 @@
+/*
+** A stack kept in one contiguous array instead of a linked list
+**
+** Same idea and same functions as StackLinkedList.c, but the values sit next to each
+** other in an array that doubles whenever it fills up. A push is just a store and a
+** pop is just a load, with no malloc or free per value and no 16 byte node holding a
+** 4 byte int. The first SMALL_STACK values fit in a buffer inside the stack itself,
+** so small stacks never allocate at all. A stack can also live on the C stack (see
+** init_stack), which is handy for depth first searches and the like.
+**
+** push_n pushes a whole batch of values with one memcpy. pop_n pops a batch in one
+** call, but copies them one at a time since they come out in reverse order.
+**
+** Time Complexity
+** Push:   O(1) amortized (Worst case O(n) when the array has to grow)
+** Pop:    O(1) (Worst case)
+** Search: O(n)
+**
+** Note: This stack is meant to only store numbers greater than or to 0
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Values that fit in the stack itself before it has to allocate
+#define SMALL_STACK 32
+
+struct stack {
+	int* items;   // Points at small until the stack outgrows it
+	int size;     // Number of values on the stack
+	int capacity; // Number of values items can hold
+	int small[SMALL_STACK];
+};
+
+void init_stack(struct stack* s);
+void release_stack(struct stack* s);
+struct stack* create_stack(int use_slab);
+void delete_stack(struct stack* s);
+void push(struct stack* s, int value);
+int pop(struct stack* s);
+void push_n(struct stack* s, const int values[], int n);
+int pop_n(struct stack* s, int values[], int n);
+int is_empty(struct stack* s);
+void print_stack(struct stack* s);
+void benchmark(int count);
+
+// Set up an empty stack in memory the caller owns, e.g. a local variable.
+// Don't copy the struct afterwards, items may point into it.
+void init_stack(struct stack* s)
+{
+	s->items = s->small;
+	s->size = 0;
+	s->capacity = SMALL_STACK;
+}
+
+// Free whatever init_stack'd stack allocated, but not the stack itself
+void release_stack(struct stack* s)
+{
+	if (s->items != s->small)
+		free(s->items);
+	init_stack(s);
+}
+
+// Create initial stack. use_slab is only there so this is a drop in for
+// StackLinkedList.c's create_stack, there are no nodes to put in a slab.
+struct stack* create_stack(int use_slab)
+{
+	struct stack* new_stack;
+	new_stack = malloc(sizeof(struct stack));
+	(void)use_slab;
+	init_stack(new_stack);
+	return new_stack;
+}
+
+// Delete the stack
+void delete_stack(struct stack* s)
+{
+	release_stack(s);
+	free(s);
+}
+
+// Make room for at least capacity values, doubling so pushes stay O(1) amortized
+static void reserve(struct stack* s, int capacity)
+{
+	int new_capacity = s->capacity;
+
+	if (capacity <= s->capacity)
+		return;
+
+	while (new_capacity < capacity)
+		new_capacity *= 2;
+
+	// Case: Moving out of the small buffer, copy the values over by hand
+	if (s->items == s->small)
+	{
+		s->items = malloc(new_capacity * sizeof(int));
+		memcpy(s->items, s->small, s->size * sizeof(int));
+	}
+	else
+		s->items = realloc(s->items, new_capacity * sizeof(int));
+	s->capacity = new_capacity;
+}
+
+// Return 1 if stack is empty or 0 if stack is not empty
+int is_empty(struct stack* s)
+{
+	return s->size == 0;
+}
+
+// Push new value on top of stack
+void push(struct stack* s, int value)
+{
+	if (s->size == s->capacity)
+		reserve(s, s->size + 1);
+	s->items[s->size++] = value;
+}
+
+// Pop a value from the top of the stack, or -1 if it's empty
+int pop(struct stack* s)
+{
+	if (s->size == 0)
+		return -1;
+	return s->items[--s->size];
+}
+
+// Push n values, values[n - 1] ends up on top
+void push_n(struct stack* s, const int values[], int n)
+{
+	reserve(s, s->size + n);
+	memcpy(&s->items[s->size], values, n * sizeof(int));
+	s->size += n;
+}
+
+// Pop up to n values into values, the top of the stack goes in values[0]
+// just like n calls to pop would. Returns how many were popped.
+int pop_n(struct stack* s, int values[], int n)
+{
+	int i;
+
+	if (n > s->size)
+		n = s->size;
+	for (i = 0; i < n; i++)
+		values[i] = s->items[s->size - 1 - i];
+	s->size -= n;
+	return n;
+}
+
+// For debugging purposes
+void print_stack(struct stack* s)
+{
+	int i;
+
+	printf("\n");
+	for (i = s->size - 1; i >= 0; i--)
+		printf("%d\n", s->items[i]);
+	printf("\n");
+}
+
+// What StackLinkedList.c does per value, for comparison
+struct node {
+	int value;
+	struct node* next;
+};
+
+// Time a depth first style workload (push a few, pop one, repeat, then
+// drain) against this stack and against a malloc per push linked stack
+void benchmark(int count)
+{
+	struct stack s;
+	struct node* top = NULL;
+	struct node* temp;
+	clock_t start;
+	double array_time, list_time;
+	long sum = 0;
+	int i;
+
+	init_stack(&s);
+	start = clock();
+	for (i = 0; i < count; i++)
+	{
+		push(&s, i);
+		push(&s, i);
+		push(&s, i);
+		sum += pop(&s);
+	}
+	while (!is_empty(&s))
+		sum += pop(&s);
+	array_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+	release_stack(&s);
+
+	start = clock();
+	for (i = 0; i < count; i++)
+	{
+		int j;
+		for (j = 0; j < 3; j++)
+		{
+			temp = malloc(sizeof(struct node));
+			temp->value = i;
+			temp->next = top;
+			top = temp;
+		}
+		sum += top->value;
+		temp = top;
+		top = top->next;
+		free(temp);
+	}
+	while (top != NULL)
+	{
+		sum += top->value;
+		temp = top;
+		top = top->next;
+		free(temp);
+	}
+	list_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	// 3 pushes and 3 pops for every i
+	printf("Array:  %.2f ns per operation\n", array_time * 1e9 / (6.0 * count));
+	printf("Linked: %.2f ns per operation\n", list_time * 1e9 / (6.0 * count));
+	printf("(checksum %ld)\n\n", sum);
+}
+
+int main()
+{
+	int choice, value, n, i;
+	int* values;
+	struct stack* my_stack = create_stack(1);
+
+	printf("Hello there! Welcome to stackify!\n");
+	printf("We pride ourselves in stacking names, so tell us, what would you like to do...\n\n");
+
+	do {
+
+		printf("1. Push a value onto the stack.\n");
+		printf("2. Pop the top value from the stack.\n");
+		printf("3. Print the current stack\n");
+		printf("4. Check if stack is empty\n");
+		printf("5. Push several values onto the stack\n");
+		printf("6. Pop several values from the stack\n");
+		printf("7. Benchmark against a linked stack\n");
+		printf("0. Exit the program\n");
+		scanf("%d", &choice);
+
+		if (choice == 1)
+		{
+			printf("What value would you like to put on the stack?\n");
+			scanf("%d", &value);
+
+			push(my_stack, value);
+		}
+		else if (choice == 2)
+		{
+			value = pop(my_stack);
+
+			printf("Just popped %d from the stack\n", value);
+		}
+		else if (choice == 3)
+			print_stack(my_stack);
+		else if (choice == 4)
+		{
+			if (is_empty(my_stack))
+				printf("The stack is empty!\n");
+			else
+				printf("There exist an item(s) on the stack\n");
+		}
+		else if (choice == 5 || choice == 6)
+		{
+			printf("How many values?\n");
+			scanf("%d", &n);
+			if (n < 0)
+				n = 0;
+			values = malloc((n + 1) * sizeof(int));
+
+			if (choice == 5)
+			{
+				printf("Enter the values, separated by spaces\n");
+				for (i = 0; i < n; i++)
+					scanf("%d", &values[i]);
+				push_n(my_stack, values, n);
+			}
+			else
+			{
+				n = pop_n(my_stack, values, n);
+				printf("Just popped");
+				for (i = 0; i < n; i++)
+					printf(" %d", values[i]);
+				printf(" from the stack\n");
+			}
+
+			free(values);
+		}
+		else if (choice == 7)
+		{
+			printf("How many rounds?\n");
+			scanf("%d", &value);
+			benchmark(value);
+		}
+	} while(choice != 0);
+
+	printf("Goodbyte!\n");
+	// Free up stack memory
+	delete_stack(my_stack);
+	exit(0);
+}
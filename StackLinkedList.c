@@ -9,9 +9,49 @@
 ** Search: O(n) (Because we have to potentially pop the entire stack of n values during search)
 **
 ** Note: This stack is meant to only store numbers greater than or to 0
+**
+** There is also a lock free version (lf_stack) that any number of threads can push
+** to and pop from at once, for using a stack as a shared pool of work. It's a Treiber
+** stack: push and pop read the top, do their work, and then swing the top over with a
+** single compare and swap, starting over if another thread got there first.
+**
+** The classic problem with that is ABA. Thread 1 reads top = A with A->next = B and
+** stalls, meanwhile other threads pop A, pop B, and push A back. Top is A again, so
+** thread 1's compare and swap happily sets top to B, which isn't on the stack anymore.
+** To catch that the top carries a tag that goes up by one on every change, packed into
+** the 16 bits of the pointer that x86-64 and ARM64 don't use, so the compare and swap
+** fails if anything happened in between. Popped nodes are never freed while the stack
+** is alive, they go on a free list (another tagged stack) to be reused, so a stalled
+** thread reading A->next never touches freed memory.
+**
+** When a compare and swap fails, which only happens when threads are fighting over the
+** top, a thread tries the elimination array instead. A push parks its node in a random
+** slot for a little while, and a pop that finds a parked node takes it. The two cancel
+** out without touching the top at all, so the more contention there is the more work
+** gets done off to the side. Build with -pthread.
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "Slab.h"
+
+#define CACHE_LINE 64
+// Pointers only use the low 48 bits, the rest holds the tag
+#define TAG_SHIFT 48
+#define POINTER_MASK ((UINT64_C(1) << TAG_SHIFT) - 1)
+#define ELIMINATION_SLOTS 16
+// How many times a push checks whether its parked node was taken
+#define ELIMINATION_SPINS 64
+// Values of an elimination slot that aren't a parked node
+#define SLOT_EMPTY ((uintptr_t)0)
+#define SLOT_TAKEN ((uintptr_t)1)
+
+_Static_assert(sizeof(void*) == 8, "the lock free stack packs a tag into 64 bit pointers");
 
 struct node {
 	int value;
@@ -20,14 +60,34 @@ struct node {
 
 struct stack {
 	struct node* top;
+	struct slab* pool; // Nodes come from here if the stack opted into a slab
 };
 
-struct stack* create_stack(void);
+struct lf_node {
+	int value;
+	_Atomic(struct lf_node*) next; // Other threads may read it while we write it
+};
+
+// Each part lives on its own cache line so threads working on the
+// top don't slow down threads working on the free list and vice versa
+struct lf_stack {
+	_Alignas(CACHE_LINE) _Atomic uint64_t top; // Tagged pointer to the top node
+	_Alignas(CACHE_LINE) _Atomic uint64_t free_list; // Tagged pointer to nodes to reuse
+	_Alignas(CACHE_LINE) _Atomic uintptr_t elimination[ELIMINATION_SLOTS];
+};
+
+struct stack* create_stack(int use_slab);
 void delete_stack(struct stack* s);
 void push(struct stack* s, int value);
 int pop(struct stack* s);
 int is_empty(struct stack* s);
 void print_stack(struct stack* s); 
+struct lf_stack* create_lf_stack(void);
+void delete_lf_stack(struct lf_stack* s);
+void lf_push(struct lf_stack* s, int value);
+int lf_pop(struct lf_stack* s);
+int stress_test(int num_threads, int values_per_thread);
+void benchmark(int seconds_per_run);
 
 // For debugging purposes
 void print_stack(struct stack* s)
@@ -49,6 +109,14 @@ void delete_stack(struct stack* s)
 {
 	struct node* temp;
 	
+	// With a slab every node goes away at once with the slab
+	if (s->pool != NULL)
+	{
+		slab_destroy(s->pool);
+		free(s);
+		return;
+	}
+	
 	temp = s->top;
 	
 	while (s->top != NULL)
@@ -61,12 +129,13 @@ void delete_stack(struct stack* s)
 	free(s);
 }
 
-// Create initial stack
-struct stack* create_stack() 
+// Create initial stack, with its own slab of nodes if use_slab is set
+struct stack* create_stack(int use_slab) 
 {
 	struct stack* new_stack;
-	new_stack = malloc(sizeof(struct node));
+	new_stack = malloc(sizeof(struct stack));
 	new_stack->top = NULL;
+	new_stack->pool = use_slab ? slab_create(sizeof(struct node)) : NULL;
 	return new_stack;
 }
 
@@ -84,7 +153,10 @@ void push(struct stack* s, int value)
 {
 	struct node* new_node;
 	
-	new_node = malloc(sizeof(struct node));
+	if (s->pool != NULL)
+		new_node = slab_alloc(s->pool);
+	else
+		new_node = malloc(sizeof(struct node));
 	new_node->value = value;
 	new_node->next = s->top;
 	s->top = new_node;
@@ -102,15 +174,343 @@ int pop(struct stack* s)
 	value = s->top->value;
 	temp = s->top;
 	s->top = s->top->next;
-	free(temp);
+	if (s->pool != NULL)
+		slab_free(s->pool, temp);
+	else
+		free(temp);
 	
 	return value;
 }
 
+static uint64_t tag_pointer(struct lf_node* node, uint64_t tag)
+{
+	return (uint64_t)(uintptr_t)node | (tag << TAG_SHIFT);
+}
+
+static struct lf_node* untag_pointer(uint64_t tagged)
+{
+	return (struct lf_node*)(uintptr_t)(tagged & POINTER_MASK);
+}
+
+// Try once to push node onto a tagged stack, returns 0 if another thread beat us to it
+static int try_push(_Atomic uint64_t* head, struct lf_node* node)
+{
+	uint64_t old = atomic_load(head);
+	
+	atomic_store_explicit(&node->next, untag_pointer(old), memory_order_relaxed);
+	return atomic_compare_exchange_strong(head, &old, tag_pointer(node, (old >> TAG_SHIFT) + 1));
+}
+
+// Try once to pop a node off a tagged stack. Returns 0 if another thread beat
+// us to it, otherwise 1 with the node in *node (NULL if the stack was empty).
+static int try_pop(_Atomic uint64_t* head, struct lf_node** node)
+{
+	uint64_t old = atomic_load(head);
+	struct lf_node* top = untag_pointer(old);
+	
+	*node = top;
+	if (top == NULL)
+		return 1;
+	
+	// top may have been popped and reused since we read old, in which case
+	// next is garbage, but then the tag changed and the swap fails anyway
+	return atomic_compare_exchange_strong(head, &old,
+		tag_pointer(atomic_load_explicit(&top->next, memory_order_relaxed), (old >> TAG_SHIFT) + 1));
+}
+
+// Cheap per thread random numbers for picking elimination slots
+static int random_slot(void)
+{
+	static _Thread_local uint32_t seed;
+	
+	if (seed == 0)
+		seed = (uint32_t)(uintptr_t)&seed | 1;
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed % ELIMINATION_SLOTS;
+}
+
+// Park node in an elimination slot for a while hoping a pop takes it.
+// Returns 1 if one did, 0 if we took the node back.
+static int eliminate_push(struct lf_stack* s, struct lf_node* node)
+{
+	_Atomic uintptr_t* slot = &s->elimination[random_slot()];
+	uintptr_t expected = SLOT_EMPTY;
+	int i;
+	
+	if (!atomic_compare_exchange_strong(slot, &expected, (uintptr_t)node))
+		return 0;
+	
+	for (i = 0; i < ELIMINATION_SPINS && atomic_load_explicit(slot, memory_order_relaxed) == (uintptr_t)node; i++)
+		;
+	
+	// Case: Nobody came, take the node back. Only a pop can change the
+	//       slot while our node is in it, and it always leaves SLOT_TAKEN.
+	expected = (uintptr_t)node;
+	if (atomic_compare_exchange_strong(slot, &expected, SLOT_EMPTY))
+		return 0;
+	
+	// Case: A pop took it. The slot stays SLOT_TAKEN until we empty it, so
+	//       nobody can park the same node there again (if it gets reused)
+	//       while we still might be trying to take it back.
+	atomic_store(slot, SLOT_EMPTY);
+	return 1;
+}
+
+// Take a node that a push parked in an elimination slot, or NULL if there isn't one
+static struct lf_node* eliminate_pop(struct lf_stack* s)
+{
+	_Atomic uintptr_t* slot = &s->elimination[random_slot()];
+	uintptr_t parked = atomic_load(slot);
+	
+	if (parked == SLOT_EMPTY || parked == SLOT_TAKEN)
+		return NULL;
+	if (!atomic_compare_exchange_strong(slot, &parked, SLOT_TAKEN))
+		return NULL;
+	return (struct lf_node*)parked;
+}
+
+// Create an empty lock free stack
+struct lf_stack* create_lf_stack(void)
+{
+	struct lf_stack* s;
+	int i;
+	
+	s = aligned_alloc(CACHE_LINE, sizeof(struct lf_stack));
+	atomic_init(&s->top, 0);
+	atomic_init(&s->free_list, 0);
+	for (i = 0; i < ELIMINATION_SLOTS; i++)
+		atomic_init(&s->elimination[i], SLOT_EMPTY);
+	return s;
+}
+
+// Delete a lock free stack. No other thread may be using it anymore.
+void delete_lf_stack(struct lf_stack* s)
+{
+	struct lf_node* node;
+	
+	while (try_pop(&s->top, &node) && node != NULL)
+		free(node);
+	while (try_pop(&s->free_list, &node) && node != NULL)
+		free(node);
+	free(s);
+}
+
+// Push new value on top of the stack, safe to call from any thread
+void lf_push(struct lf_stack* s, int value)
+{
+	struct lf_node* node;
+	
+	// Reuse a popped node if there is one
+	while (!try_pop(&s->free_list, &node))
+		;
+	if (node == NULL)
+		node = malloc(sizeof(struct lf_node));
+	node->value = value;
+	
+	while (!try_push(&s->top, node) && !eliminate_push(s, node))
+		;
+}
+
+// Pop a value from the top of the stack, safe to call from any thread.
+// Returns -1 if the stack is empty.
+int lf_pop(struct lf_stack* s)
+{
+	struct lf_node* node;
+	int value;
+	
+	for (;;)
+	{
+		if (try_pop(&s->top, &node))
+			break;
+		if ((node = eliminate_pop(s)) != NULL)
+			break;
+	}
+	
+	if (node == NULL)
+		return -1;
+	
+	value = node->value;
+	while (!try_push(&s->free_list, node))
+		;
+	return value;
+}
+
+// What each stress test or benchmark thread gets to work with
+struct worker {
+	pthread_t thread;
+	struct lf_stack* lf;
+	struct stack* locked; // Benchmark against this one instead if it's set
+	pthread_mutex_t* lock;
+	int first_value;
+	int num_values;
+	int* popped; // How many times each value came off the stack
+	atomic_int* stop;
+	long ops;
+};
+
+// Push this thread's values, popping after every other push so pushes
+// and pops from all the threads are mixed together
+static void* stress_worker(void* arg)
+{
+	struct worker* w = arg;
+	int i, value;
+	
+	for (i = 0; i < w->num_values; i++)
+	{
+		lf_push(w->lf, w->first_value + i);
+		if (i % 2 == 1 && (value = lf_pop(w->lf)) >= 0)
+			atomic_fetch_add((atomic_int*)&w->popped[value], 1);
+	}
+	return NULL;
+}
+
+// Hammer the lock free stack from num_threads threads, then check that every
+// value pushed came off exactly once. Returns 1 if it did.
+int stress_test(int num_threads, int values_per_thread)
+{
+	struct lf_stack* s = create_lf_stack();
+	struct worker* workers;
+	int* popped;
+	int i, value, total, ok = 1;
+	
+	total = num_threads * values_per_thread;
+	workers = malloc(num_threads * sizeof(struct worker));
+	popped = calloc(total, sizeof(atomic_int));
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		workers[i].lf = s;
+		workers[i].first_value = i * values_per_thread;
+		workers[i].num_values = values_per_thread;
+		workers[i].popped = popped;
+		pthread_create(&workers[i].thread, NULL, stress_worker, &workers[i]);
+	}
+	for (i = 0; i < num_threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	
+	// Whatever is left on the stack counts too
+	while ((value = lf_pop(s)) >= 0)
+		popped[value]++;
+	
+	for (i = 0; i < total; i++)
+	{
+		if (popped[i] != 1)
+		{
+			printf("Value %d came off the stack %d times!\n", i, popped[i]);
+			ok = 0;
+		}
+	}
+	
+	free(workers);
+	free(popped);
+	delete_lf_stack(s);
+	return ok;
+}
+
+// Push and pop in pairs until told to stop, counting operations
+static void* bench_worker(void* arg)
+{
+	struct worker* w = arg;
+	long ops = 0;
+	
+	while (!atomic_load_explicit(w->stop, memory_order_relaxed))
+	{
+		if (w->locked != NULL)
+		{
+			pthread_mutex_lock(w->lock);
+			push(w->locked, 1);
+			pthread_mutex_unlock(w->lock);
+			pthread_mutex_lock(w->lock);
+			pop(w->locked);
+			pthread_mutex_unlock(w->lock);
+		}
+		else
+		{
+			lf_push(w->lf, 1);
+			lf_pop(w->lf);
+		}
+		ops += 2;
+	}
+	
+	w->ops = ops;
+	return NULL;
+}
+
+// Run num_threads threads against one of the stacks, returns operations per second
+static double bench_run(struct lf_stack* lf, struct stack* locked, pthread_mutex_t* lock,
+						int num_threads, int seconds)
+{
+	struct worker* workers;
+	struct timespec start, end;
+	atomic_int stop = 0;
+	long total = 0;
+	int i;
+	
+	workers = malloc(num_threads * sizeof(struct worker));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < num_threads; i++)
+	{
+		workers[i].lf = lf;
+		workers[i].locked = locked;
+		workers[i].lock = lock;
+		workers[i].stop = &stop;
+		pthread_create(&workers[i].thread, NULL, bench_worker, &workers[i]);
+	}
+	
+	sleep(seconds);
+	atomic_store(&stop, 1);
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		total += workers[i].ops;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	
+	free(workers);
+	return total / (end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+// Time the lock free stack against a regular stack behind a mutex
+// on 1, 2, 4, ... threads up to the number of cores
+void benchmark(int seconds_per_run)
+{
+	struct lf_stack* lf = create_lf_stack();
+	struct stack* locked = create_stack(1);
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	double mutex_ops, lf_ops;
+	long cores;
+	int num_threads;
+	
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1)
+		cores = 1;
+	
+	printf("\nthreads   mutex (ops/sec)   lock free (ops/sec)\n");
+	for (num_threads = 1; ; num_threads *= 2)
+	{
+		if (num_threads > cores)
+			num_threads = cores;
+		
+		mutex_ops = bench_run(NULL, locked, &lock, num_threads, seconds_per_run);
+		lf_ops = bench_run(lf, NULL, NULL, num_threads, seconds_per_run);
+		printf("%7d   %15.0f   %19.0f\n", num_threads, mutex_ops, lf_ops);
+		
+		if (num_threads == cores)
+			break;
+	}
+	printf("\n");
+	
+	delete_stack(locked);
+	delete_lf_stack(lf);
+}
+
 int main()
 {
-	int choice, value;
-	struct stack* my_stack = create_stack();
+	int choice, value, threads;
+	struct stack* my_stack = create_stack(1);
 	
 	printf("Hello there! Welcome to stackify!\n");
 	printf("We pride ourselves in stacking names, so tell us, what would you like to do...\n\n");
@@ -121,6 +521,9 @@ int main()
 		printf("2. Pop the top value from the stack.\n");
 		printf("3. Print the current stack\n");
 		printf("4. Check if stack is empty\n");
+		printf("5. Print allocation stats\n");
+		printf("6. Stress test the lock free stack\n");
+		printf("7. Benchmark the lock free stack against a mutex\n");
 		printf("0. Exit the program\n");
 		scanf("%d", &choice);
 		
@@ -146,10 +549,21 @@ int main()
 			else
 				printf("There exist an item(s) on the stack\n");
 		}
+		else if (choice == 5)
+			slab_print_stats(my_stack->pool, "Node");
+		else if (choice == 6)
+		{
+			printf("How many threads, and how many values should each push? (separated by a space)\n");
+			scanf("%d %d", &threads, &value);
+			if (stress_test(threads, value))
+				printf("Every value came off the stack exactly once\n");
+		}
+		else if (choice == 7)
+			benchmark(1);
 	} while(choice != 0);
 	
 	printf("Goodbyte!\n");
 	// Free up stack memory
-	free(my_stack);
+	delete_stack(my_stack);
 	exit(0);
 }
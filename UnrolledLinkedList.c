@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Slab.h"
+#include "Intern.h"
+
+/*
+** An unrolled linked list that stores names in SORTED lexicographic order
+**
+** Does the same job as SinglyLinkedList.c, but instead of one name per node every
+** node holds a small sorted array of up to NODE_NAMES of them. Walking the list only
+** follows a pointer (and takes a cache miss) once per node instead of once per name,
+** and searches skip a whole node by looking at its last name alone, so printing and
+** searching chase about NODE_NAMES times fewer pointers. A node is two cache lines.
+**
+** Inserting into a full node splits it in half, with the top half going into a new
+** node after it. A name that goes after the last name of a full node starts a new
+** node instead, so names added in order (like a sorted file) pack every node full.
+** Deleting from a node that drops below half full either merges it with the node
+** after it, if they fit in one, or borrows that node's first name.
+**
+** Like the other lists, nodes don't hold the names themselves but the list's interned
+** copy of them (see Intern.h), so a name is 8 bytes of the node and checking whether
+** it's the one we're after is a pointer compare.
+**
+** Time Complexity (K is NODE_NAMES)
+** Insert: O(n/K) (Walk the nodes to the right one, then shift at most K names in it)
+** Delete: O(n/K) (Same)
+** Search: O(n/K) (Walk the nodes, then binary search inside one)
+** Bulk load: O(n/K + count) for names that are already sorted (see insert_sorted)
+*/
+#define MAX_LENGTH 100
+// Names per node, 14 makes a node 128 bytes
+#define NODE_NAMES 14
+#define CACHE_LINE 64
+
+struct list {
+	struct node* head;
+	struct slab* pool; // Nodes come from here if the list opted into a slab
+	struct intern_pool* names; // Every name in a node is this pool's copy
+	long num_nodes;
+	long num_names;
+};
+struct node {
+	struct node* next;
+	int count; // Names in use, always at least 1
+	const char* names[NODE_NAMES]; // Interned, sorted, the first count are used
+};
+
+struct list* create_list(int use_slab);
+void insert(struct list* linked_list, char name[]);
+int find(struct list* linked_list, char name[]);
+void print_list(struct list* linked_list);
+int delete_node(struct list* linked_list, char name[]);
+void delete_list(struct list* linked_list);
+void insert_sorted(struct list* linked_list, char* names[], int count);
+int load_file(struct list* linked_list, const char* filename);
+void print_stats(struct list* linked_list);
+
+
+// Create a new empty List, with its own slab of nodes if use_slab is set
+struct list* create_list(int use_slab)
+{
+	struct list* new_list;
+	
+	new_list = malloc(sizeof(struct list));
+	new_list->head = NULL;
+	// Nodes start on a cache line so a walk touches as few lines as it can
+	new_list->pool = use_slab ? slab_create_aligned(sizeof(struct node), CACHE_LINE) : NULL;
+	new_list->names = intern_create();
+	new_list->num_nodes = 0;
+	new_list->num_names = 0;
+	
+	return new_list;
+}
+
+// Allocate an empty node from the list's slab, or the heap if it doesn't have one
+static struct node* alloc_node(struct list* linked_list)
+{
+	struct node* node;
+	
+	if (linked_list->pool != NULL)
+		node = slab_alloc(linked_list->pool);
+	else
+		node = aligned_alloc(CACHE_LINE, sizeof(struct node));
+	node->next = NULL;
+	node->count = 0;
+	linked_list->num_nodes++;
+	return node;
+}
+
+// Give a node back to wherever it was allocated from
+static void release_node(struct list* linked_list, struct node* node)
+{
+	if (linked_list->pool != NULL)
+		slab_free(linked_list->pool, node);
+	else
+		free(node);
+	linked_list->num_nodes--;
+}
+
+void delete_list(struct list* linked_list)
+{
+	struct node* current_node;
+	
+	// With a slab every node goes away at once with the slab
+	if (linked_list->pool != NULL)
+		slab_destroy(linked_list->pool);
+	else
+	{
+		while (linked_list->head != NULL)
+		{
+			current_node = linked_list->head;
+			linked_list->head = linked_list->head->next;
+			free(current_node);
+		}
+	}
+	intern_destroy(linked_list->names);
+	free(linked_list);
+}
+
+// Index of the first name in node that doesn't come before name,
+// or node->count if they all do
+static int position(struct node* node, const char* name)
+{
+	int low = 0;
+	int high = node->count;
+	int middle;
+	
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		if (strcmp(node->names[middle], name) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+// Starting at node (the head if it's NULL), find the first node whose last name
+// doesn't come before name. That's the node name is in if it's anywhere, and where
+// it goes if it isn't. Past every node, it's the last one. NULL if the list is empty.
+static struct node* find_node(struct list* linked_list, struct node* node, const char* name)
+{
+	if (node == NULL)
+		node = linked_list->head;
+	
+	// Only the last name of every node we skip gets looked at
+	while (node != NULL && node->next != NULL && strcmp(node->names[node->count - 1], name) < 0)
+		node = node->next;
+	return node;
+}
+
+// Put an interned name at index pos of node, splitting the node first if it's
+// full. Returns the node the name ended up in.
+static struct node* insert_at(struct list* linked_list, struct node* node, int pos, const char* name)
+{
+	struct node* new_node;
+	int half;
+	
+	if (node->count == NODE_NAMES)
+	{
+		new_node = alloc_node(linked_list);
+		new_node->next = node->next;
+		node->next = new_node;
+	
+		// Case: Name goes after the last name, so it starts the new node
+		//       and the full one is left full
+		if (pos == NODE_NAMES)
+		{
+			node = new_node;
+			pos = 0;
+		}
+		// Case: Split the node in half and insert into the half it goes in
+		else
+		{
+			half = NODE_NAMES / 2;
+			memcpy(new_node->names, node->names + half, (NODE_NAMES - half) * sizeof(const char*));
+			new_node->count = NODE_NAMES - half;
+			node->count = half;
+			if (pos > half)
+			{
+				node = new_node;
+				pos -= half;
+			}
+		}
+	}
+	
+	memmove(node->names + pos + 1, node->names + pos, (node->count - pos) * sizeof(const char*));
+	node->names[pos] = name;
+	node->count++;
+	linked_list->num_names++;
+	return node;
+}
+
+// Insert name somewhere from the node after onwards (or anywhere if after is NULL),
+// keeping the list sorted, and return the node it went in. Feeding that node back
+// in as after means sorted names usually go straight in with no searching.
+static struct node* insert_after(struct list* linked_list, struct node* after, char name[])
+{
+	const char* interned;
+	struct node* node;
+	
+	interned = intern(linked_list->names, name);
+	
+	// Case: The list is empty
+	if (linked_list->head == NULL)
+	{
+		linked_list->head = alloc_node(linked_list);
+		return insert_at(linked_list, linked_list->head, 0, interned);
+	}
+	
+	// Case: Name comes before after, so start over from the head
+	if (after != NULL && strcmp(after->names[0], name) > 0)
+		after = NULL;
+	
+	node = find_node(linked_list, after, name);
+	return insert_at(linked_list, node, position(node, name), interned);
+}
+
+// Insert a name into the List
+void insert(struct list* linked_list, char name[])
+{
+	insert_after(linked_list, NULL, name);
+}
+
+// Search the list for a name, returns 1 if it's there
+int find(struct list* linked_list, char name[])
+{
+	struct node* node;
+	const char* interned;
+	int pos;
+	
+	// Case: The name was never interned, so no node can have it
+	interned = intern_find(linked_list->names, name);
+	if (interned == NULL)
+		return 0;
+	
+	node = find_node(linked_list, NULL, name);
+	if (node == NULL)
+		return 0;
+	pos = position(node, name);
+	return pos < node->count && node->names[pos] == interned;
+}
+
+// Top node back up after a delete left it less than half full, by merging
+// the node after it in if they fit in one or else borrowing its first name
+static void rebalance(struct list* linked_list, struct node* node)
+{
+	struct node* next = node->next;
+	
+	if (next == NULL || node->count >= NODE_NAMES / 2)
+		return;
+	
+	if (node->count + next->count <= NODE_NAMES)
+	{
+		memcpy(node->names + node->count, next->names, next->count * sizeof(const char*));
+		node->count += next->count;
+		node->next = next->next;
+		release_node(linked_list, next);
+		return;
+	}
+	
+	node->names[node->count++] = next->names[0];
+	next->count--;
+	memmove(next->names, next->names + 1, next->count * sizeof(const char*));
+}
+
+int delete_node(struct list* linked_list, char name[])
+{
+	struct node** link;
+	struct node* node;
+	const char* interned;
+	int pos;
+	
+	interned = intern_find(linked_list->names, name);
+	if (linked_list->head == NULL || interned == NULL)
+		return 0;
+	
+	// Same walk as find_node, but keeping the link to the node so it can be unhooked
+	link = &linked_list->head;
+	while ((*link)->next != NULL && strcmp((*link)->names[(*link)->count - 1], name) < 0)
+		link = &(*link)->next;
+	node = *link;
+	
+	pos = position(node, name);
+	if (pos == node->count || node->names[pos] != interned)
+		return 0;
+	
+	// We've found the matching name
+	node->count--;
+	memmove(node->names + pos, node->names + pos + 1, (node->count - pos) * sizeof(const char*));
+	linked_list->num_names--;
+	
+	// Case: That was its last name
+	if (node->count == 0)
+	{
+		*link = node->next;
+		release_node(linked_list, node);
+	}
+	else
+		rebalance(linked_list, node);
+	return 1;
+}
+
+// Add count names at once. If the names are already sorted the whole batch is
+// appended in one pass, filling nodes as it goes, O(n/K + count) instead of a
+// walk per name. Names that are out of order still end up in the right place,
+// they just cost a walk from the head.
+void insert_sorted(struct list* linked_list, char* names[], int count)
+{
+	struct node* tail = NULL;
+	int i;
+	
+	for (i = 0; i < count; i++)
+		tail = insert_after(linked_list, tail, names[i]);
+}
+
+// Same as insert_sorted but streams the names out of a file, one per word.
+// Returns the number of names read, or -1 if the file couldn't be opened.
+int load_file(struct list* linked_list, const char* filename)
+{
+	FILE* fp;
+	struct node* tail = NULL;
+	char name[MAX_LENGTH];
+	int count = 0;
+	
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	
+	while (fscanf(fp, "%99s", name) == 1)
+	{
+		tail = insert_after(linked_list, tail, name);
+		count++;
+	}
+	
+	fclose(fp);
+	return count;
+}
+
+void print_list(struct list* linked_list)
+{
+	struct node* current_node;
+	int i;
+	
+	printf("\n");
+	
+	for (current_node = linked_list->head; current_node != NULL; current_node = current_node->next)
+		for (i = 0; i < current_node->count; i++)
+			printf("%s ", current_node->names[i]);
+	printf("\n\n");
+}
+
+void print_stats(struct list* linked_list)
+{
+	printf("\n%ld names in %ld nodes (%zu bytes each)", linked_list->num_names, linked_list->num_nodes, sizeof(struct node));
+	if (linked_list->num_nodes > 0)
+		printf(", %.1f of %d names per node", (double)linked_list->num_names / linked_list->num_nodes, NODE_NAMES);
+	printf("\n");
+	if (linked_list->pool != NULL)
+		slab_print_stats(linked_list->pool, "Node");
+	intern_print_stats(linked_list->names, "Name");
+}
+
+int main(void)
+{
+	int choice, count;
+	char name[MAX_LENGTH];
+	char filename[256];
+	clock_t start;
+	
+	struct list* linked_list;
+	linked_list = create_list(1);
+	
+	printf("Welcome to the names database!\n");
+	printf("We're happy to store all the names you like.\n");
+	
+	do {
+		printf("What would you like to do?\n");
+		printf("1. Add a name to the list.\n");
+		printf("2. Print the list\n");
+		printf("3. Delete name from the list\n");
+		printf("4. Print allocation stats\n");
+		printf("5. Load names from a sorted file\n");
+		printf("6. Look up a name\n");
+		printf("0. Exit the program\n");
+		scanf("%d", &choice);
+	
+		if (choice == 1)
+		{
+			printf("Please enter the name you wish to add to the list\n");
+			scanf("%99s", name);
+			insert(linked_list, name);
+		}
+		else if (choice == 2)
+			print_list(linked_list);
+		else if (choice == 3)
+		{
+			printf("Please enter the name you wish to delete\n");
+			scanf("%99s", name);
+			if (delete_node(linked_list, name))
+				printf("Succesfully deleted %s from the list!\n", name);
+			else
+				printf("Sorry I could not find %s in the list\n", name);
+		}
+		else if (choice == 4)
+			print_stats(linked_list);
+		else if (choice == 5)
+		{
+			printf("Please enter the file you wish to load\n");
+			scanf("%255s", filename);
+			start = clock();
+			count = load_file(linked_list, filename);
+			if (count < 0)
+				printf("Sorry I could not open %s\n", filename);
+			else
+				printf("Loaded %d names in %.3f ms\n", count, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+		}
+		else if (choice == 6)
+		{
+			printf("Please enter the name you wish to look up\n");
+			scanf("%99s", name);
+			if (find(linked_list, name))
+				printf("%s is in the list!\n", name);
+			else
+				printf("Sorry I could not find %s in the list\n", name);
+		}
+	} while (choice != 0);
+	
+	delete_list(linked_list);
+	
+	system("PAUSE");
+	
+	exit(0);
+}